@@ -1,7 +1,14 @@
+// Compile with:
+//   gcc -O2 -pthread bignum.c -o bignum
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdint.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
 
 void *
 xmalloc(size_t n)
@@ -38,6 +45,7 @@ xcalloc(size_t n, size_t m)
 #define MAX(A_, B_) ((A_) > (B_) ? (A_) : (B_))
 
 typedef unsigned long UWORD;
+typedef unsigned __int128 UDWORD;
 
 typedef struct {
     UWORD *words;
@@ -73,18 +81,33 @@ number_copy(Number a)
     return (Number) {words, a.size};
 }
 
-Number
-number_add(Number a, Number b)
+void
+number_free(Number a)
+{
+    free(a.words);
+}
+
+// Writes a + b into 'dst', which must have room for MAX(a.size, b.size) + 1 words; 'dst'
+// may be 'a.words', but not 'b.words'. Returns the size of the result.
+static
+size_t
+words_add(UWORD *dst, Number a, Number b)
 {
+    if (!b.size) {
+        if (dst != a.words && a.size) {
+            memcpy(dst, a.words, a.size * sizeof(UWORD));
+        }
+        return a.size;
+    }
     if (!a.size) {
-        return number_copy(b);
+        memcpy(dst, b.words, b.size * sizeof(UWORD));
+        return b.size;
     }
-    if (!b.size) {
-        return number_copy(a);
+    size_t size = MAX(a.size, b.size) + 1;
+    if (dst != a.words) {
+        memcpy(dst, a.words, a.size * sizeof(UWORD));
     }
-    unsigned size = MAX(a.size, b.size) + 1;
-    UWORD *words = xcalloc(size, sizeof(UWORD));
-    memcpy(words, a.words, a.size * sizeof(UWORD));
+    memset(dst + a.size, 0, (size - a.size) * sizeof(UWORD));
 
     __asm__(
         "mov %[Size], %%rcx\n"
@@ -93,28 +116,47 @@ number_add(Number a, Number b)
         "mov (%[Src]), %%r9\n"
         "add %%r9, (%[Dst])\n"
 
-        "jmp loop_ctnue\n"
-        "loop_begin:\n"
+        "jmp loop_ctnue%=\n"
+        "loop_begin%=:\n"
         "mov (%[Src],%%r8,8), %%r9\n"
         "adcq %%r9, (%[Dst],%%r8,8)\n"
-        "loop_ctnue:\n"
+        "loop_ctnue%=:\n"
         "inc %%r8\n"
-        "loop loop_begin\n"
+        "loop loop_begin%=\n"
 
-        "adcq $0, (%[Dst],%%r8,8)\n"
+        "jnc loop_done%=\n"
+        "loop_carry%=:\n"
+        "addq $1, (%[Dst],%%r8,8)\n"
+        "inc %%r8\n"
+        "jc loop_carry%=\n"
+        "loop_done%=:\n"
 
         : /* no outputs */
 
         : [Size] "r" (b.size)
-        , [Dst] "r" (words)
+        , [Dst] "r" (dst)
         , [Src] "r" (b.words)
 
         : "cc", "memory", "r8", "r9", "rcx"
     );
 
-    if (size && !words[size - 1]) {
+    if (size && !dst[size - 1]) {
         --size;
     }
+    return size;
+}
+
+Number
+number_add(Number a, Number b)
+{
+    if (!a.size) {
+        return number_copy(b);
+    }
+    if (!b.size) {
+        return number_copy(a);
+    }
+    UWORD *words = xmalloc2(MAX(a.size, b.size) + 1, sizeof(UWORD));
+    size_t size = words_add(words, a, b);
     return (Number) {words, size};
 }
 
@@ -131,26 +173,25 @@ number_cmp(Number a, Number b)
     int result;
 
     __asm__(
-        "xor %%rcx, %%rcx\n"
-        "z_loop:\n"
-        "mov (%[BufB],%%rcx,8), %%rbx\n"
-        "cmpq %%rbx, (%[BufA],%%rcx,8)\n"
-        "jne differ\n"
-        "add $1, %%rcx\n"
-        "cmpq %%rcx, %[Size]\n"
-        "jne z_loop\n"
+        "mov %[Size], %%rcx\n"
+        "z_loop%=:\n"
+        "mov -8(%[BufB],%%rcx,8), %%rbx\n"
+        "cmpq %%rbx, -8(%[BufA],%%rcx,8)\n"
+        "jne differ%=\n"
+        "sub $1, %%rcx\n"
+        "jnz z_loop%=\n"
 
         "xor %[Result], %[Result]\n"
-        "jmp z_done\n"
+        "jmp z_done%=\n"
 
-        "differ:\n"
-        "jg greater\n"
+        "differ%=:\n"
+        "ja greater%=\n"
         "mov $-1, %[Result]\n"
-        "jmp z_done\n"
-        "greater:\n"
+        "jmp z_done%=\n"
+        "greater%=:\n"
         "mov $1, %[Result]\n"
 
-        "z_done:\n"
+        "z_done%=:\n"
 
         : [Result] "=r" (result)
 
@@ -163,14 +204,19 @@ number_cmp(Number a, Number b)
     return result;
 }
 
-// assumes a >= b
-Number
-number_sub(Number a, Number b)
+// Writes a - b into 'dst', which must have room for a.size words and may be 'a.words'.
+// Assumes a >= b. Returns the size of the result.
+static
+size_t
+words_sub(UWORD *dst, Number a, Number b)
 {
-    Number c = number_copy(a);
+    if (dst != a.words && a.size) {
+        memcpy(dst, a.words, a.size * sizeof(UWORD));
+    }
     if (!a.size || !b.size) {
-        return c;
+        return a.size;
     }
+    size_t size = a.size;
 
     __asm__(
         "mov %[SizeB], %%rcx\n"
@@ -179,253 +225,2392 @@ number_sub(Number a, Number b)
         "mov (%[BufB]), %%r9\n"
         "sub %%r9, (%[BufC])\n"
 
-        "jmp y_loop_ctnue\n"
-        "y_loop_begin:\n"
+        "jmp y_loop_ctnue%=\n"
+        "y_loop_begin%=:\n"
         "mov (%[BufB],%%r8,8), %%r9\n"
         "sbbq %%r9, (%[BufC],%%r8,8)\n"
-        "y_loop_ctnue:\n"
+        "y_loop_ctnue%=:\n"
         "inc %%r8\n"
-        "loop y_loop_begin\n"
+        "loop y_loop_begin%=\n"
 
-        "jnc y_done\n"
-        "sub $1, (%[BufC],%%r8,8)\n"
-        "y_done:\n"
+        "jnc y_done%=\n"
+        "y_borrow%=:\n"
+        "subq $1, (%[BufC],%%r8,8)\n"
+        "inc %%r8\n"
+        "jc y_borrow%=\n"
+        "y_done%=:\n"
 
-        "y_norm:\n"
+        "y_norm%=:\n"
         "sub $1, %[SizeC]\n"
-        "jc y_norm_done\n"
+        "jc y_norm_done%=\n"
         "cmpq $0, (%[BufC],%[SizeC],8)\n"
-        "je y_norm\n"
-        "y_norm_done:\n"
+        "je y_norm%=\n"
+        "y_norm_done%=:\n"
         "add $1, %[SizeC]\n"
 
-        : [SizeC] "+r" (c.size)
+        : [SizeC] "+r" (size)
 
         : [SizeB] "r" (b.size)
         , [BufB] "r" (b.words)
-        , [BufC] "r" (c.words)
+        , [BufC] "r" (dst)
 
         : "cc", "memory", "r8", "r9", "rcx"
     );
 
-    return c;
+    return size;
 }
 
-static inline
-unsigned long
-fastpow_u64(unsigned long base, unsigned char exponent)
+// assumes a >= b
+Number
+number_sub(Number a, Number b)
 {
-    unsigned long result = 1;
-    for (; exponent; exponent >>= 1) {
-        if (exponent & 1) {
-            result *= base;
-        }
-        base *= base;
-    }
-    return result;
+    UWORD *words = xmalloc2(a.size, sizeof(UWORD));
+    size_t size = words_sub(words, a, b);
+    return (Number) {words, size};
 }
 
-void
-number_print(Number a, unsigned radix)
+static
+UWORD
+words_addmul_1(UWORD *dst, const UWORD *src, size_t n, UWORD m)
 {
-    static const char *const table = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ";
-    // digits per word: dpw[i] = floor(log_{i}(2^{64} - 1))
-    static const unsigned char dpw[] = {
-        0, 0, 63, 40, 31, 27, 24, 22, 21, 20, 19, 18, 17, 17, 16, 16, 15, 15, 15, 15, 14, 14, 14,
-        14, 13, 13, 13, 13, 13, 13, 13, 12, 12, 12, 12, 12, 12,
-    };
-    if (!a.size) {
-        fputs("0\n", stdout);
-        return;
+    UWORD carry = 0;
+    for (size_t i = 0; i < n; ++i) {
+        UDWORD t = (UDWORD) src[i] * m + dst[i] + carry;
+        dst[i] = (UWORD) t;
+        carry = t >> 64;
     }
+    return carry;
+}
 
-    const unsigned char exponent = dpw[radix];
-
-    UWORD *buf = xmalloc2(a.size, sizeof(UWORD));
-    memcpy(buf, a.words, a.size * sizeof(UWORD));
-
-    char *res = xmalloc2(a.size + 1, exponent + 1);
-    char *tail = res;
-
-    unsigned long temp_size = a.size;
-    __asm__(
-        "sub $8, %[Buf]\n"
-
-        "outer:\n"
-        "mov %[Size], %%rcx\n"
-        "xor %%rdx, %%rdx\n"
+static
+UWORD
+words_submul_1(UWORD *dst, const UWORD *src, size_t n, UWORD m)
+{
+    UWORD borrow = 0;
+    for (size_t i = 0; i < n; ++i) {
+        UDWORD t = (UDWORD) src[i] * m + borrow;
+        UWORD lo = (UWORD) t;
+        borrow = (t >> 64) + (dst[i] < lo);
+        dst[i] -= lo;
+    }
+    return borrow;
+}
 
-        "divpow:\n"
-        "mov (%[Buf],%%rcx,8), %%rax\n"
-        "div %[Pow]\n"
-        "mov %%rax, (%[Buf],%%rcx,8)\n"
-        "loop divpow\n"
+// Operands shorter than this (in words) are multiplied by the schoolbook method; see
+// 'bignum bench' for how to pick the value.
+static size_t mul_karatsuba_threshold = 32;
 
-        "mov %%rdx, %%rax\n"
-        "mov %[Dpw], %%rcx\n"
+// dst[0, na + nb) = a[0, na) * b[0, nb)
+static
+void
+mul_basecase(UWORD *dst, const UWORD *a, size_t na, const UWORD *b, size_t nb)
+{
+    memset(dst, 0, na * sizeof(UWORD));
+    for (size_t i = 0; i < nb; ++i) {
+        dst[na + i] = words_addmul_1(dst + i, a, na, b[i]);
+    }
+}
 
-        "divradix:\n"
-        "xor %%rdx, %%rdx\n"
-        "div %[Radix]\n"
-        "mov (%[Table],%%rdx), %%dl\n"
-        "mov %%dl, (%[Tail])\n"
-        "add $1, %[Tail]\n"
-        "loop divradix\n"
+// dst[0, n) = a[0, n) + b[0, n); returns the carry. 'dst' may be either operand.
+static
+UWORD
+words_add_n(UWORD *dst, const UWORD *a, const UWORD *b, size_t n)
+{
+    UWORD carry = 0;
+    for (size_t i = 0; i < n; ++i) {
+        UDWORD t = (UDWORD) a[i] + b[i] + carry;
+        dst[i] = (UWORD) t;
+        carry = t >> 64;
+    }
+    return carry;
+}
 
-        "cmpq $0, (%[Buf],%[Size],8)\n"
-        "jne outer\n"
-        "sub $1, %[Size]\n"
-        "jnz outer\n"
+// dst[0, n) = a[0, n) - b[0, n); returns the borrow. 'dst' may be either operand.
+static
+UWORD
+words_sub_n(UWORD *dst, const UWORD *a, const UWORD *b, size_t n)
+{
+    UWORD borrow = 0;
+    for (size_t i = 0; i < n; ++i) {
+        UWORD x = a[i];
+        UWORD y = b[i];
+        UWORD d = x - y - borrow;
+        borrow = (x < y) | ((x == y) & borrow);
+        dst[i] = d;
+    }
+    return borrow;
+}
 
-        "add $8, %[Buf]\n"
+// dst[0, n) += c; returns the carry.
+static
+UWORD
+words_add_1(UWORD *dst, size_t n, UWORD c)
+{
+    for (size_t i = 0; c && i < n; ++i) {
+        dst[i] += c;
+        c = dst[i] < c;
+    }
+    return c;
+}
 
-        : [Tail] "+r" (tail)
-        , [Buf] "+r" (buf)
-        , [Size] "+r" (temp_size)
+// dst[0, nx) = |x[0, nx) - y[0, ny)| with ny <= nx; returns true if x < y.
+static
+bool
+words_absdiff(UWORD *dst, const UWORD *x, size_t nx, const UWORD *y, size_t ny)
+{
+    bool x_less = false;
+    size_t i = nx;
+    while (i > ny) {
+        if (x[--i]) {
+            goto sub;
+        }
+    }
+    while (i) {
+        --i;
+        if (x[i] != y[i]) {
+            x_less = x[i] < y[i];
+            break;
+        }
+    }
+    if (x_less) {
+        // x < y means x has no nonzero words above 'ny'.
+        words_sub_n(dst, y, x, ny);
+        memset(dst + ny, 0, (nx - ny) * sizeof(UWORD));
+        return true;
+    }
+sub:
+    memcpy(dst, x, nx * sizeof(UWORD));
+    if (words_sub_n(dst, dst, y, ny)) {
+        // absorbed by the (then nonzero) rest of x.
+        for (size_t j = ny; !dst[j]--; ++j) {
+        }
+    }
+    return false;
+}
 
-        : [Table] "r" (table)
-        , [Radix] "r" ((unsigned long) radix)
-        , [Dpw] "r" ((unsigned long) exponent)
-        , [Pow] "r" (fastpow_u64(radix, exponent))
+// Number of scratch words 'words_mul' needs.
+static inline
+size_t
+mul_scratch_size(size_t na, size_t nb)
+{
+    size_t lo = na < nb ? na : nb;
+    if (lo < mul_karatsuba_threshold) {
+        return 0;
+    }
+    return 10 * MAX(na, nb) + 1024;
+}
 
-        : "cc", "memory", "rax", "rcx", "rdx"
-    );
+// dst[0, 2n) = a[0, n) * b[0, n), by Karatsuba's method in its subtractive form:
+// a0 b1 + a1 b0 = a0 b0 + a1 b1 - (a0 - a1)(b0 - b1).
+static
+void
+mul_karatsuba(UWORD *dst, const UWORD *a, const UWORD *b, size_t n, UWORD *scratch)
+{
+    if (n < mul_karatsuba_threshold || n < 8) {
+        mul_basecase(dst, a, n, b, n);
+        return;
+    }
+    const size_t l = (n + 1) / 2;
+    const size_t h = n - l;
+
+    UWORD *da = scratch;
+    UWORD *db = da + l;
+    UWORD *t = db + l;
+    UWORD *mid = t + 2 * l;
+    UWORD *rest = mid + 2 * l + 1;
+
+    bool neg = words_absdiff(da, a, l, a + l, h) ^ words_absdiff(db, b, l, b + l, h);
+
+    mul_karatsuba(dst, a, b, l, rest);
+    mul_karatsuba(dst + 2 * l, a + l, b + l, h, rest);
+    mul_karatsuba(t, da, db, l, rest);
+
+    // mid = a0 b0 + a1 b1 -/+ (a0 - a1)(b0 - b1)
+    memcpy(mid, dst, 2 * l * sizeof(UWORD));
+    UWORD c = words_add_n(mid, mid, dst + 2 * l, 2 * h);
+    mid[2 * l] = words_add_1(mid + 2 * h, 2 * l - 2 * h, c);
+    if (neg) {
+        mid[2 * l] += words_add_n(mid, mid, t, 2 * l);
+    } else {
+        mid[2 * l] -= words_sub_n(mid, mid, t, 2 * l);
+    }
 
-    free(buf);
+    UWORD carry = words_add_n(dst + l, dst + l, mid, 2 * l + 1);
+    words_add_1(dst + 3 * l + 1, 2 * n - 3 * l - 1, carry);
+}
 
-    const size_t nres = tail - res;
-    for (size_t i = 0; i < nres / 2; ++i) {
-        char tmp = res[i];
-        res[i] = res[nres - i - 1];
-        res[nres - i - 1] = tmp;
+// dst[0, na + nb) = a[0, na) * b[0, nb)
+static
+void
+mul_any(UWORD *dst, const UWORD *a, size_t na, const UWORD *b, size_t nb, UWORD *scratch)
+{
+    if (na < nb) {
+        const UWORD *tp = a;
+        a = b;
+        b = tp;
+        size_t tn = na;
+        na = nb;
+        nb = tn;
     }
-    size_t start = 0;
-    while (res[start] == '0') {
-        ++start;
+    if (nb < mul_karatsuba_threshold) {
+        mul_basecase(dst, a, na, b, nb);
+        return;
+    }
+    if (na == nb) {
+        mul_karatsuba(dst, a, b, na, scratch);
+        return;
+    }
+    // cut the longer operand into nb-word pieces.
+    memset(dst, 0, (na + nb) * sizeof(UWORD));
+    UWORD *tmp = scratch;
+    scratch += 2 * nb;
+    for (size_t off = 0; off < na; off += nb) {
+        size_t len = na - off < nb ? na - off : nb;
+        mul_any(tmp, a + off, len, b, nb, scratch);
+        UWORD carry = words_add_n(dst + off, dst + off, tmp, len + nb);
+        words_add_1(dst + off + len + nb, na - off - len, carry);
     }
-    res[nres] = '\n';
-    fwrite(res + start, 1, nres + 1 - start, stdout);
-
-    free(res);
 }
 
+// Writes a * b into 'dst', which must have room for a.size + b.size words and must not
+// overlap with either operand; 'scratch' must have room for mul_scratch_size(a.size, b.size)
+// words. Returns the size of the result.
 static
 size_t
-calc_ndigits(unsigned radix, size_t n)
+words_mul(UWORD *dst, Number a, Number b, UWORD *scratch)
 {
-    return (n / 64 + 1) * (32 - __builtin_clz(radix));
+    if (!a.size || !b.size) {
+        return 0;
+    }
+    mul_any(dst, a.words, a.size, b.words, b.size, scratch);
+    size_t size = a.size + b.size;
+    if (!dst[size - 1]) {
+        --size;
+    }
+    return size;
 }
 
 Number
-number_parse(const char *s, size_t ns, unsigned radix)
+number_mul(Number a, Number b)
 {
-    static const unsigned char table[] = {
-        ['0'] = 0, ['1'] = 1, ['2'] = 2, ['3'] = 3, ['4'] = 4, ['5'] = 5, ['6'] = 6, ['7'] = 7,
-        ['8'] = 8, ['9'] = 9,
-
-        ['A'] = 10, ['B'] = 11, ['C'] = 12, ['D'] = 13, ['E'] = 14, ['F'] = 15, ['G'] = 16,
-        ['H'] = 17, ['I'] = 18, ['J'] = 19, ['K'] = 20, ['L'] = 21, ['M'] = 22, ['N'] = 23,
-        ['O'] = 24, ['P'] = 25, ['Q'] = 26, ['R'] = 27, ['S'] = 28, ['T'] = 29, ['U'] = 30,
-        ['V'] = 31, ['W'] = 32, ['X'] = 33, ['Y'] = 34, ['Z'] = 25,
+    UWORD *words = xmalloc2(a.size + b.size, sizeof(UWORD));
+    UWORD *scratch = xmalloc2(mul_scratch_size(a.size, b.size), sizeof(UWORD));
+    size_t size = words_mul(words, a, b, scratch);
+    free(scratch);
+    return (Number) {words, size};
+}
 
-        ['a'] = 10, ['b'] = 11, ['c'] = 12, ['d'] = 13, ['e'] = 14, ['f'] = 15, ['g'] = 16,
-        ['h'] = 17, ['i'] = 18, ['j'] = 19, ['k'] = 20, ['l'] = 21, ['m'] = 22, ['n'] = 23,
-        ['o'] = 24, ['p'] = 25, ['q'] = 26, ['r'] = 27, ['s'] = 28, ['t'] = 29, ['u'] = 30,
-        ['v'] = 31, ['w'] = 32, ['x'] = 33, ['y'] = 34, ['z'] = 25,
-    };
-    const char *end = s + ns;
+// Divides the two-word number (hi, lo) by 'd'; requires hi < d.
+static inline
+UWORD
+div_2by1(UWORD hi, UWORD lo, UWORD d, UWORD *rem)
+{
+    UWORD q;
+    __asm__("divq %[D]" : "=a" (q), "=d" (*rem) : "a" (lo), "d" (hi), [D] "rm" (d) : "cc");
+    return q;
+}
 
-    const char *ptr = s;
-    while (1) {
-        if (ptr == end) {
-            return (Number) {NULL, 0};
+// Computes the quotient and the remainder of a / b (Knuth's algorithm D). 'q' must have room
+// for a.size - b.size + 1 words, 'r' for b.size words, and 'scratch' for a.size + b.size + 1
+// words; none of them may overlap with the operands. 'b' must be nonzero.
+static
+void
+words_divmod(UWORD *q, size_t *qsize, UWORD *r, size_t *rsize, Number a, Number b, UWORD *scratch)
+{
+    if (a.size < b.size) {
+        if (a.size) {
+            memcpy(r, a.words, a.size * sizeof(UWORD));
         }
-        if (table[(unsigned char) *ptr]) {
-            break;
+        *rsize = a.size;
+        *qsize = 0;
+        return;
+    }
+    const size_t n = b.size;
+    const size_t m = a.size - n;
+
+    if (n == 1) {
+        const UWORD d = b.words[0];
+        UWORD rem = 0;
+        for (size_t i = a.size; i--;) {
+            q[i] = div_2by1(rem, a.words[i], d, &rem);
         }
-        ++ptr;
+        r[0] = rem;
+        *rsize = !!rem;
+        *qsize = a.size - !q[a.size - 1];
+        return;
     }
 
-    UWORD *words = xmalloc2(calc_ndigits(radix, end - ptr), sizeof(UWORD));
-    words[0] = table[(unsigned char) *ptr];
-    size_t size = 1;
-    __asm__(
-        "jmp x_outer_ctnue\n"
-
-        "x_outer_begin:\n"
-        "movzbq (%[Ptr]), %%rdx\n"
-        "movzbq (%[Table],%%rdx), %%rdx\n"
-
-        "xor %%rcx, %%rcx\n"
-
-        "x_inner:\n"
-        "mov (%[Buf],%%rcx,8), %%rax\n"
-        "mov %%rdx, %%r10\n"
-        "mul %[Radix]\n"
-        "add %%r10, %%rax\n"
-        "adc $0, %%rdx\n"
-        "mov %%rax, (%[Buf],%%rcx,8)\n"
-        "add $1, %%rcx\n"
-        "cmp %%rcx, %[Size]\n"
-        "jne x_inner\n"
-
-        "mov %%rdx, (%[Buf],%%rcx,8)\n"
-        "test %%rdx, %%rdx\n"
-        "jz x_outer_ctnue\n"
-        "add $1, %[Size]\n"
-
-        "x_outer_ctnue:\n"
-        "add $1, %[Ptr]\n"
-        "cmp %[Ptr], %[End]\n"
-        "jne x_outer_begin\n"
-
-        : [Size] "+r" (size)
-        , [Ptr] "+r" (ptr)
+    // normalize so that the top word of the divisor has its high bit set.
+    const unsigned shift = __builtin_clzl(b.words[n - 1]);
+    UWORD *vn = scratch;
+    UWORD *un = scratch + n;
+    if (shift) {
+        for (size_t i = n - 1; i; --i) {
+            vn[i] = (b.words[i] << shift) | (b.words[i - 1] >> (64 - shift));
+        }
+        vn[0] = b.words[0] << shift;
+        un[a.size] = a.words[a.size - 1] >> (64 - shift);
+        for (size_t i = a.size - 1; i; --i) {
+            un[i] = (a.words[i] << shift) | (a.words[i - 1] >> (64 - shift));
+        }
+        un[0] = a.words[0] << shift;
+    } else {
+        memcpy(vn, b.words, n * sizeof(UWORD));
+        memcpy(un, a.words, a.size * sizeof(UWORD));
+        un[a.size] = 0;
+    }
 
-        : [Radix] "r" ((unsigned long) radix)
-        , [Buf] "r" (words)
-        , [End] "r" (end)
-        , [Table] "r" (table)
+    const UWORD vtop = vn[n - 1];
+    const UWORD vnext = vn[n - 2];
+    for (size_t j = m + 1; j--;) {
+        UWORD qhat, rhat;
+        bool rhat_overflow = false;
+        if (un[j + n] >= vtop) {
+            qhat = ~(UWORD) 0;
+            rhat = un[j + n - 1] + vtop;
+            rhat_overflow = rhat < vtop;
+        } else {
+            qhat = div_2by1(un[j + n], un[j + n - 1], vtop, &rhat);
+        }
+        while (!rhat_overflow &&
+               (UDWORD) qhat * vnext > (((UDWORD) rhat << 64) | un[j + n - 2]))
+        {
+            --qhat;
+            rhat += vtop;
+            rhat_overflow = rhat < vtop;
+        }
 
-        : "cc", "memory", "rax", "rcx", "rdx", "r10"
-    );
+        UWORD borrow = words_submul_1(un + j, vn, n, qhat);
+        UWORD top = un[j + n];
+        un[j + n] = top - borrow;
+        if (top < borrow) {
+            // qhat was one too large; add the divisor back.
+            --qhat;
+            UWORD carry = 0;
+            for (size_t i = 0; i < n; ++i) {
+                UDWORD t = (UDWORD) un[j + i] + vn[i] + carry;
+                un[j + i] = (UWORD) t;
+                carry = t >> 64;
+            }
+            un[j + n] += carry;
+        }
+        q[j] = qhat;
+    }
 
-    return (Number) {words, size};
-}
+    size_t nq = m + 1;
+    while (nq && !q[nq - 1]) {
+        --nq;
+    }
+    *qsize = nq;
 
-void
-number_dump(Number a)
-{
-    for (size_t i = 0; i < a.size; ++i) {
-        printf(" | %lu", a.words[i]);
+    if (shift) {
+        for (size_t i = 0; i < n - 1; ++i) {
+            r[i] = (un[i] >> shift) | (un[i + 1] << (64 - shift));
+        }
+        r[n - 1] = un[n - 1] >> shift;
+    } else {
+        memcpy(r, un, n * sizeof(UWORD));
     }
-    printf("\n");
+    size_t nr = n;
+    while (nr && !r[nr - 1]) {
+        --nr;
+    }
+    *rsize = nr;
 }
 
+// 'b' must be nonzero.
 void
-number_free(Number a)
+number_divmod(Number a, Number b, Number *quot, Number *rem)
 {
-    free(a.words);
+    size_t nq = a.size >= b.size ? a.size - b.size + 1 : 0;
+    UWORD *qw = xmalloc2(nq, sizeof(UWORD));
+    UWORD *rw = xmalloc2(b.size, sizeof(UWORD));
+    UWORD *scratch = xmalloc2(a.size + b.size + 1, sizeof(UWORD));
+    size_t qsize, rsize;
+    words_divmod(qw, &qsize, rw, &rsize, a, b, scratch);
+    free(scratch);
+    *quot = (Number) {qw, qsize};
+    *rem = (Number) {rw, rsize};
 }
 
-Number
-read_num(void)
-{
-    char s[100];
-    fgets(s, sizeof(s), stdin);
-    size_t n = strlen(s);
-    if (n && s[n - 1] == '\n') {
-        --n;
-    }
-    return number_parse(s, n, 10);
-}
+//-----------------------------------------------------------------------------
+// GCD and modular inverse: Lehmer's algorithm with double-digit (128-bit) leading parts.
+//
+// Each round runs Euclid on the top 128 bits of both operands, for as long as Jebelean's
+// condition guarantees that the quotients are those of the full operands and the cofactors
+// stay below 2^62, and then applies the accumulated 2x2 matrix to the full operands in a
+// single pass. That retires about 62 bits per pass instead of one quotient. Rounds where
+// the leading parts give nothing (very different sizes, huge quotients) fall back to a
+// full division step.
 
-int
-main()
+typedef struct {
+    Number num;
+    bool neg;
+} Cofactor;
+
+// dst[0, n + 1) = |a x - b y| (if 'sub'), or a x + b y, where n = MAX(nx, ny); returns true
+// if a x - b y was negative. Requires a, b < 2^63. Returns the size in '*ndst'.
+static
+bool
+words_lincomb(UWORD *dst, size_t *ndst, UWORD a, Number x, UWORD b, Number y, bool sub)
+{
+    const size_t n = MAX(x.size, y.size);
+    bool neg = false;
+    if (sub) {
+        __int128 acc = 0;
+        for (size_t i = 0; i < n; ++i) {
+            acc += (UDWORD) a * (i < x.size ? x.words[i] : 0);
+            acc -= (UDWORD) b * (i < y.size ? y.words[i] : 0);
+            dst[i] = (UWORD) acc;
+            acc >>= 64;
+        }
+        dst[n] = (UWORD) acc;
+        if (acc < 0) {
+            // two's complement negation
+            neg = true;
+            UWORD carry = 1;
+            for (size_t i = 0; i <= n; ++i) {
+                dst[i] = ~dst[i] + carry;
+                carry = carry && !dst[i];
+            }
+        }
+    } else {
+        UDWORD acc = 0;
+        for (size_t i = 0; i < n; ++i) {
+            acc += (UDWORD) a * (i < x.size ? x.words[i] : 0);
+            acc += (UDWORD) b * (i < y.size ? y.words[i] : 0);
+            dst[i] = (UWORD) acc;
+            acc >>= 64;
+        }
+        dst[n] = (UWORD) acc;
+    }
+    size_t size = n + 1;
+    while (size && !dst[size - 1]) {
+        --size;
+    }
+    *ndst = size;
+    return neg;
+}
+
+// Top 128 bits of the 'at'-word number 'w' (zero-extended from 'n' words), shifted left by 'sh'.
+// Requires at >= 3.
+static inline
+UDWORD
+top128(const UWORD *w, size_t n, size_t at, unsigned sh)
+{
+    UWORD hi = at - 1 < n ? w[at - 1] : 0;
+    UWORD mid = at - 2 < n ? w[at - 2] : 0;
+    UWORD lo = at - 3 < n ? w[at - 3] : 0;
+    UDWORD r = ((UDWORD) hi << 64) | mid;
+    if (sh) {
+        r = (r << sh) | (lo >> (64 - sh));
+    }
+    return r;
+}
+
+// Euclid on the leading parts x >= y. After k steps the remainders are
+//   x_k = +/-(a0 X - b0 Y) and x_{k+1} = +/-(a1 X - b1 Y).
+// Returns k; 0 means the leading parts could not tell a single quotient.
+static
+size_t
+lehmer_cosequence(UDWORD x, UDWORD y, UWORD *a0, UWORD *b0, UWORD *a1, UWORD *b1)
+{
+    const UWORD lim = (UWORD) 1 << 62;
+    UWORD ua = 1, ub = 0, va = 0, vb = 1;
+    size_t k = 0;
+    while (y) {
+        UDWORD q;
+        UDWORD r = x - y;
+        if (r < y) {
+            q = 1;
+        } else if (r - y < y) {
+            q = 2;
+            r -= y;
+        } else {
+            q = x / y;
+            r = x - q * y;
+        }
+        if (q >= lim) {
+            break;
+        }
+        UDWORD na = ua + q * va;
+        UDWORD nb = ub + q * vb;
+        if (na >= lim || nb >= lim) {
+            break;
+        }
+        // Jebelean's condition, for both cofactors.
+        UDWORD big = MAX(na, nb);
+        UDWORD bigdiff = MAX(na + va, nb + vb);
+        if (r < big || y - r < bigdiff) {
+            break;
+        }
+        x = y;
+        y = r;
+        ua = va;
+        ub = vb;
+        va = na;
+        vb = nb;
+        ++k;
+    }
+    *a0 = ua;
+    *b0 = ub;
+    *a1 = va;
+    *b1 = vb;
+    return k;
+}
+
+// dst = x - y, signed. 'dst' must have room for MAX(x.size, y.size) + 1 words and must not
+// overlap with the operands.
+static
+void
+cofactor_sub(Cofactor *dst, Cofactor x, Cofactor y)
+{
+    if (x.neg != y.neg) {
+        dst->num.size = words_add(dst->num.words, x.num, y.num);
+        dst->neg = x.neg;
+    } else if (number_cmp(x.num, y.num) >= 0) {
+        dst->num.size = words_sub(dst->num.words, x.num, y.num);
+        dst->neg = x.neg;
+    } else {
+        dst->num.size = words_sub(dst->num.words, y.num, x.num);
+        dst->neg = !x.neg;
+    }
+    if (!dst->num.size) {
+        dst->neg = false;
+    }
+}
+
+// dst = a x - b y with x, y signed and 0 <= a, b < 2^63; negated if 'flip'.
+static
+void
+cofactor_lincomb(Cofactor *dst, UWORD a, Cofactor x, UWORD b, Cofactor y, bool flip)
+{
+    bool neg;
+    if (x.neg == y.neg) {
+        neg = x.neg ^ words_lincomb(dst->num.words, &dst->num.size, a, x.num, b, y.num, true);
+    } else {
+        words_lincomb(dst->num.words, &dst->num.size, a, x.num, b, y.num, false);
+        neg = x.neg;
+    }
+    dst->neg = dst->num.size && (neg ^ flip);
+}
+
+// Reduces |c| modulo 'm' if it has grown past it.
+static
+void
+cofactor_reduce(Cofactor *c, Number m, UWORD *tmp, UWORD *scratch)
+{
+    if (c->num.size <= m.size) {
+        return;
+    }
+    size_t nq, nr;
+    words_divmod(scratch, &nq, tmp, &nr, c->num, m, scratch + c->num.size + 1);
+    memcpy(c->num.words, tmp, nr * sizeof(UWORD));
+    c->num.size = nr;
+    if (!nr) {
+        c->neg = false;
+    }
+}
+
+// Scratch words needed by words_gcd() and words_invmod() for operands of 'na' and 'nb' words.
+static inline
+size_t
+gcd_scratch_size(size_t na, size_t nb)
+{
+    return 23 * (MAX(na, nb) + 3) + 1024;
+}
+
+// Computes the GCD of 'a' and 'b' (both nonzero) into 'g', which needs room for
+// MAX(a.size, b.size) words, and returns its size. If 'cof' is non-NULL, also computes it
+// into 'cof->num.words', which needs room for b.size words, such that a * cof = gcd (mod b).
+// 'buf' needs gcd_scratch_size() words.
+static
+size_t
+gcd_run(UWORD *g, Number a, Number b, Cofactor *cof, UWORD *buf)
+{
+    if (number_cmp(a, b) < 0 && !cof) {
+        Number tmp = a;
+        a = b;
+        b = tmp;
+    }
+    // for the inverse, u = b (the modulus) and v = a mod b; cofactors are those of 'a'.
+    const size_t N = MAX(a.size, b.size) + 3;
+    UWORD *u = buf;
+    UWORD *v = u + N;
+    UWORD *t = v + N;
+    UWORD *q = t + N;
+    UWORD *r = q + N;
+    UWORD *cbuf = r + N;
+    UWORD *scratch = cbuf + 4 * N;
+    size_t nu, nv;
+
+    Cofactor cu = {{NULL, 0}, false};
+    Cofactor cv = {{NULL, 0}, false};
+    Cofactor ct = {{NULL, 0}, false};
+    const Number m = b;
+    if (cof) {
+        cu.num.words = cbuf;
+        cv.num.words = cbuf + N;
+        ct.num.words = cbuf + 2 * N;
+        cv.num.words[0] = 1;
+        cv.num.size = 1;
+
+        memcpy(u, b.words, b.size * sizeof(UWORD));
+        nu = b.size;
+        words_divmod(q, &(size_t) {0}, v, &nv, a, b, scratch);
+    } else {
+        memcpy(u, a.words, a.size * sizeof(UWORD));
+        nu = a.size;
+        memcpy(v, b.words, b.size * sizeof(UWORD));
+        nv = b.size;
+    }
+
+    while (nv) {
+        if (!cof && nu <= 2) {
+            UDWORD x = nu == 2 ? ((UDWORD) u[1] << 64) | u[0] : u[0];
+            UDWORD y = nv == 2 ? ((UDWORD) v[1] << 64) | v[0] : v[0];
+            while (y) {
+                UDWORD r = x % y;
+                x = y;
+                y = r;
+            }
+            u[0] = (UWORD) x;
+            u[1] = (UWORD) (x >> 64);
+            nu = u[1] ? 2 : 1;
+            nv = 0;
+            break;
+        }
+
+        if (nu >= 3 && nu - nv <= 1) {
+            const unsigned sh = __builtin_clzl(u[nu - 1]);
+            UDWORD x = top128(u, nu, nu, sh);
+            UDWORD y = top128(v, nv, nu, sh);
+            UWORD a0, b0, a1, b1;
+            if (lehmer_cosequence(x, y, &a0, &b0, &a1, &b1)) {
+                Number U = {u, nu};
+                Number V = {v, nv};
+                size_t nt;
+                bool neg0 = words_lincomb(t, &nt, a0, U, b0, V, true);
+                bool neg1 = words_lincomb(q, &nv, a1, U, b1, V, true);
+                if (cof) {
+                    cofactor_lincomb(&ct, a0, cu, b0, cv, neg0);
+                    cofactor_lincomb(&cv, a1, cu, b1, cv, neg1);
+                    Cofactor tmp = cu;
+                    cu = ct;
+                    ct = tmp;
+                    cofactor_reduce(&cu, m, r, scratch);
+                    cofactor_reduce(&cv, m, r, scratch);
+                }
+                // rotate buffers: u <- t, v <- q
+                UWORD *old_u = u;
+                UWORD *old_v = v;
+                u = t;
+                nu = nt;
+                v = q;
+                t = old_u;
+                q = old_v;
+                if (number_cmp((Number) {u, nu}, (Number) {v, nv}) < 0) {
+                    // cannot happen with exact quotients, but costs nothing to handle.
+                    UWORD *tmp = u;
+                    u = v;
+                    v = tmp;
+                    size_t ntmp = nu;
+                    nu = nv;
+                    nv = ntmp;
+                    if (cof) {
+                        Cofactor ctmp = cu;
+                        cu = cv;
+                        cv = ctmp;
+                    }
+                }
+                continue;
+            }
+        }
+
+        // full division step: (u, v) <- (v, u mod v)
+        size_t nq, nr;
+        words_divmod(q, &nq, t, &nr, (Number) {u, nu}, (Number) {v, nv}, scratch);
+        if (cof) {
+            // (cu, cv) <- (cv, cu - q cv)
+            UWORD *prod = scratch;
+            size_t nprod = words_mul(prod, (Number) {q, nq}, cv.num, scratch + nq + cv.num.size);
+            Cofactor qcv = {{prod, nprod}, cv.neg && nprod};
+            cofactor_sub(&ct, cu, qcv);
+            cofactor_reduce(&ct, m, r, scratch);
+            Cofactor tmp = cu;
+            cu = cv;
+            cv = ct;
+            ct = tmp;
+        }
+        UWORD *old_u = u;
+        u = v;
+        nu = nv;
+        v = t;
+        nv = nr;
+        t = old_u;
+    }
+
+    memcpy(g, u, nu * sizeof(UWORD));
+    if (cof) {
+        memcpy(cof->num.words, cu.num.words, cu.num.size * sizeof(UWORD));
+        cof->num.size = cu.num.size;
+        cof->neg = cu.neg;
+    }
+    return nu;
+}
+
+// Computes the GCD of 'a' and 'b' into 'g', which needs room for MAX(a.size, b.size) words,
+// and returns its size. 'scratch' needs gcd_scratch_size() words.
+static
+size_t
+words_gcd(UWORD *g, Number a, Number b, UWORD *scratch)
+{
+    if (!a.size || !b.size) {
+        Number r = a.size ? a : b;
+        memcpy(g, r.words, r.size * sizeof(UWORD));
+        return r.size;
+    }
+    return gcd_run(g, a, b, NULL, scratch);
+}
+
+// Computes the inverse of 'a' modulo 'm' into 'inv', which needs room for m.size words.
+// Returns false if there is none (or m = 0). 'scratch' needs gcd_scratch_size() words.
+static
+bool
+words_invmod(UWORD *inv, size_t *ninv, Number a, Number m, UWORD *scratch)
+{
+    if (!m.size) {
+        return false;
+    }
+    if (m.size == 1 && m.words[0] == 1) {
+        *ninv = 0;
+        return true;
+    }
+    // the cofactor and the GCD go first, the rest is for gcd_run()
+    Cofactor c = {{scratch, 0}, false};
+    UWORD *g = scratch + m.size;
+    size_t ng = gcd_run(g, a, m, &c, g + MAX(a.size, m.size));
+    if (ng != 1 || g[0] != 1) {
+        return false;
+    }
+    if (c.neg && c.num.size) {
+        *ninv = words_sub(inv, m, c.num);
+    } else {
+        memcpy(inv, c.num.words, c.num.size * sizeof(UWORD));
+        *ninv = c.num.size;
+    }
+    return true;
+}
+
+Number
+number_gcd(Number a, Number b)
+{
+    UWORD *scratch = xmalloc2(gcd_scratch_size(a.size, b.size), sizeof(UWORD));
+    Number g = {xmalloc2(MAX(a.size, b.size) + 1, sizeof(UWORD)), 0};
+    g.size = words_gcd(g.words, a, b, scratch);
+    free(scratch);
+    return g;
+}
+
+// Computes the inverse of 'a' modulo 'm' into 'inv'. Returns false if there is none (or m = 0).
+bool
+number_invmod(Number a, Number m, Number *inv)
+{
+    UWORD *scratch = xmalloc2(gcd_scratch_size(a.size, m.size), sizeof(UWORD));
+    *inv = (Number) {xmalloc2(m.size + 1, sizeof(UWORD)), 0};
+    bool ok = words_invmod(inv->words, &inv->size, a, m, scratch);
+    free(scratch);
+    if (!ok) {
+        number_free(*inv);
+    }
+    return ok;
+}
+
+// The plain binary GCD, for comparison.
+Number
+number_gcd_binary(Number a, Number b)
+{
+    if (!a.size) {
+        return number_copy(b);
+    }
+    if (!b.size) {
+        return number_copy(a);
+    }
+    const size_t N = MAX(a.size, b.size) + 1;
+    UWORD *u = xcalloc(N, sizeof(UWORD));
+    UWORD *v = xcalloc(N, sizeof(UWORD));
+    memcpy(u, a.words, a.size * sizeof(UWORD));
+    memcpy(v, b.words, b.size * sizeof(UWORD));
+    size_t nu = a.size;
+    size_t nv = b.size;
+
+#define CTZ(W_, N_, Out_) \
+    do { \
+        size_t i_ = 0; \
+        while (!(W_)[i_]) { \
+            ++i_; \
+        } \
+        (Out_) = i_ * 64 + __builtin_ctzl((W_)[i_]); \
+    } while (0)
+
+#define SHR(W_, N_, Bits_) \
+    do { \
+        size_t wsh_ = (Bits_) / 64; \
+        unsigned bsh_ = (Bits_) % 64; \
+        size_t n_ = (N_) - wsh_; \
+        for (size_t i_ = 0; i_ < n_; ++i_) { \
+            UWORD lo_ = (W_)[i_ + wsh_] >> bsh_; \
+            UWORD hi_ = bsh_ && i_ + 1 < n_ ? (W_)[i_ + wsh_ + 1] << (64 - bsh_) : 0; \
+            (W_)[i_] = lo_ | hi_; \
+        } \
+        (N_) = n_; \
+        while ((N_) && !(W_)[(N_) - 1]) { \
+            --(N_); \
+        } \
+    } while (0)
+
+    size_t zu, zv;
+    CTZ(u, nu, zu);
+    CTZ(v, nv, zv);
+    const size_t k = zu < zv ? zu : zv;
+    SHR(u, nu, zu);
+    SHR(v, nv, zv);
+    while (1) {
+        int c = number_cmp((Number) {u, nu}, (Number) {v, nv});
+        if (!c) {
+            break;
+        }
+        if (c < 0) {
+            UWORD *tmp = u;
+            u = v;
+            v = tmp;
+            size_t ntmp = nu;
+            nu = nv;
+            nv = ntmp;
+        }
+        nu = words_sub(u, (Number) {u, nu}, (Number) {v, nv});
+        CTZ(u, nu, zu);
+        SHR(u, nu, zu);
+    }
+
+#undef SHR
+#undef CTZ
+
+    // shift back left by k
+    const size_t wsh = k / 64;
+    const unsigned bsh = k % 64;
+    UWORD *r = xcalloc(nu + wsh + 1, sizeof(UWORD));
+    for (size_t i = 0; i < nu; ++i) {
+        r[i + wsh] |= u[i] << bsh;
+        if (bsh) {
+            r[i + wsh + 1] = u[i] >> (64 - bsh);
+        }
+    }
+    size_t nr = nu + wsh + 1;
+    while (nr && !r[nr - 1]) {
+        --nr;
+    }
+    free(u);
+    free(v);
+    return (Number) {r, nr};
+}
+
+static inline
+unsigned long
+fastpow_u64(unsigned long base, unsigned char exponent)
+{
+    unsigned long result = 1;
+    for (; exponent; exponent >>= 1) {
+        if (exponent & 1) {
+            result *= base;
+        }
+        base *= base;
+    }
+    return result;
+}
+
+// digits per word: dpw[i] = floor(log_{i}(2^{64} - 1))
+static const unsigned char dpw[] = {
+    0, 0, 63, 40, 31, 27, 24, 22, 21, 20, 19, 18, 17, 17, 16, 16, 15, 15, 15, 15, 14, 14, 14,
+    14, 13, 13, 13, 13, 13, 13, 13, 12, 12, 12, 12, 12, 12,
+};
+
+// An upper bound for the number of characters 'number_format' produces.
+static inline
+size_t
+number_format_size(Number a, unsigned radix)
+{
+    return (a.size + 1) * (dpw[radix] + 1);
+}
+
+// Writes 'a' in base 'radix' into 'out', which must have room for number_format_size(a, radix)
+// characters. 'scratch' must have room for a.size words. Returns the number of characters
+// written; no newline is appended.
+size_t
+number_format(Number a, unsigned radix, char *out, UWORD *scratch)
+{
+    static const char *const table = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+    if (!a.size) {
+        out[0] = '0';
+        return 1;
+    }
+
+    const unsigned char exponent = dpw[radix];
+
+    UWORD *buf = scratch;
+    memcpy(buf, a.words, a.size * sizeof(UWORD));
+
+    char *res = out;
+    char *tail = res;
+
+    unsigned long temp_size = a.size;
+    __asm__(
+        "sub $8, %[Buf]\n"
+
+        "outer%=:\n"
+        "mov %[Size], %%rcx\n"
+        "xor %%rdx, %%rdx\n"
+
+        "divpow%=:\n"
+        "mov (%[Buf],%%rcx,8), %%rax\n"
+        "div %[Pow]\n"
+        "mov %%rax, (%[Buf],%%rcx,8)\n"
+        "loop divpow%=\n"
+
+        "mov %%rdx, %%rax\n"
+        "mov %[Dpw], %%rcx\n"
+
+        "divradix%=:\n"
+        "xor %%rdx, %%rdx\n"
+        "div %[Radix]\n"
+        "mov (%[Table],%%rdx), %%dl\n"
+        "mov %%dl, (%[Tail])\n"
+        "add $1, %[Tail]\n"
+        "loop divradix%=\n"
+
+        "cmpq $0, (%[Buf],%[Size],8)\n"
+        "jne outer%=\n"
+        "sub $1, %[Size]\n"
+        "jnz outer%=\n"
+
+        "add $8, %[Buf]\n"
+
+        : [Tail] "+r" (tail)
+        , [Buf] "+r" (buf)
+        , [Size] "+r" (temp_size)
+
+        : [Table] "r" (table)
+        , [Radix] "r" ((unsigned long) radix)
+        , [Dpw] "r" ((unsigned long) exponent)
+        , [Pow] "r" (fastpow_u64(radix, exponent))
+
+        : "cc", "memory", "rax", "rcx", "rdx"
+    );
+
+    const size_t nres = tail - res;
+    for (size_t i = 0; i < nres / 2; ++i) {
+        char tmp = res[i];
+        res[i] = res[nres - i - 1];
+        res[nres - i - 1] = tmp;
+    }
+    size_t start = 0;
+    while (res[start] == '0') {
+        ++start;
+    }
+    memmove(res, res + start, nres - start);
+    return nres - start;
+}
+
+void
+number_print(Number a, unsigned radix)
+{
+    UWORD *scratch = xmalloc2(a.size, sizeof(UWORD));
+    char *res = xmalloc2(number_format_size(a, radix), 1);
+    size_t nres = number_format(a, radix, res, scratch);
+    res[nres] = '\n';
+    fwrite(res, 1, nres + 1, stdout);
+    free(res);
+    free(scratch);
+}
+
+static
+size_t
+calc_ndigits(unsigned radix, size_t n)
+{
+    return (n / 64 + 1) * (32 - __builtin_clz(radix));
+}
+
+// Parses 's' in base 'radix' into 'words', which must have room for calc_ndigits(radix, ns)
+// words. Returns the size of the result.
+static
+size_t
+words_parse(UWORD *words, const char *s, size_t ns, unsigned radix)
+{
+    static const unsigned char table[256] = {
+        ['0'] = 0, ['1'] = 1, ['2'] = 2, ['3'] = 3, ['4'] = 4, ['5'] = 5, ['6'] = 6, ['7'] = 7,
+        ['8'] = 8, ['9'] = 9,
+
+        ['A'] = 10, ['B'] = 11, ['C'] = 12, ['D'] = 13, ['E'] = 14, ['F'] = 15, ['G'] = 16,
+        ['H'] = 17, ['I'] = 18, ['J'] = 19, ['K'] = 20, ['L'] = 21, ['M'] = 22, ['N'] = 23,
+        ['O'] = 24, ['P'] = 25, ['Q'] = 26, ['R'] = 27, ['S'] = 28, ['T'] = 29, ['U'] = 30,
+        ['V'] = 31, ['W'] = 32, ['X'] = 33, ['Y'] = 34, ['Z'] = 35,
+
+        ['a'] = 10, ['b'] = 11, ['c'] = 12, ['d'] = 13, ['e'] = 14, ['f'] = 15, ['g'] = 16,
+        ['h'] = 17, ['i'] = 18, ['j'] = 19, ['k'] = 20, ['l'] = 21, ['m'] = 22, ['n'] = 23,
+        ['o'] = 24, ['p'] = 25, ['q'] = 26, ['r'] = 27, ['s'] = 28, ['t'] = 29, ['u'] = 30,
+        ['v'] = 31, ['w'] = 32, ['x'] = 33, ['y'] = 34, ['z'] = 35,
+    };
+    const char *end = s + ns;
+
+    const char *ptr = s;
+    while (1) {
+        if (ptr == end) {
+            return 0;
+        }
+        if (table[(unsigned char) *ptr]) {
+            break;
+        }
+        ++ptr;
+    }
+
+    words[0] = table[(unsigned char) *ptr];
+    size_t size = 1;
+    __asm__(
+        "jmp x_outer_ctnue%=\n"
+
+        "x_outer_begin%=:\n"
+        "movzbq (%[Ptr]), %%rdx\n"
+        "movzbq (%[Table],%%rdx), %%rdx\n"
+
+        "xor %%rcx, %%rcx\n"
+
+        "x_inner%=:\n"
+        "mov (%[Buf],%%rcx,8), %%rax\n"
+        "mov %%rdx, %%r10\n"
+        "mul %[Radix]\n"
+        "add %%r10, %%rax\n"
+        "adc $0, %%rdx\n"
+        "mov %%rax, (%[Buf],%%rcx,8)\n"
+        "add $1, %%rcx\n"
+        "cmp %%rcx, %[Size]\n"
+        "jne x_inner%=\n"
+
+        "mov %%rdx, (%[Buf],%%rcx,8)\n"
+        "test %%rdx, %%rdx\n"
+        "jz x_outer_ctnue%=\n"
+        "add $1, %[Size]\n"
+
+        "x_outer_ctnue%=:\n"
+        "add $1, %[Ptr]\n"
+        "cmp %[Ptr], %[End]\n"
+        "jne x_outer_begin%=\n"
+
+        : [Size] "+r" (size)
+        , [Ptr] "+r" (ptr)
+
+        : [Radix] "r" ((unsigned long) radix)
+        , [Buf] "r" (words)
+        , [End] "r" (end)
+        , [Table] "r" (table)
+
+        : "cc", "memory", "rax", "rcx", "rdx", "r10"
+    );
+
+    return size;
+}
+
+Number
+number_parse(const char *s, size_t ns, unsigned radix)
+{
+    UWORD *words = xmalloc2(calc_ndigits(radix, ns), sizeof(UWORD));
+    size_t size = words_parse(words, s, ns, radix);
+    return (Number) {words, size};
+}
+
+void
+number_dump(Number a)
+{
+    for (size_t i = 0; i < a.size; ++i) {
+        printf(" | %lu", a.words[i]);
+    }
+    printf("\n");
+}
+
+// Accumulator for summing lots of numbers.
+//
+// Every limb is kept in a 128-bit cell and carries are not propagated on addition; they
+// are settled only by 'number_acc_settle'. A cell can absorb 2^64 addends before it
+// overflows, so no counting is needed in practice.
+typedef struct {
+    UDWORD *limbs;
+    size_t size;
+    size_t cap;
+} NumberAcc;
+
+NumberAcc
+number_acc_new(void)
+{
+    return (NumberAcc) {NULL, 0, 0};
+}
+
+static
+void
+number_acc_reserve(NumberAcc *acc, size_t size)
+{
+    if (size <= acc->cap) {
+        return;
+    }
+    size_t cap = MAX(size, acc->cap * 2);
+    UDWORD *limbs = xmalloc2(cap, sizeof(UDWORD));
+    if (acc->size) {
+        memcpy(limbs, acc->limbs, acc->size * sizeof(UDWORD));
+    }
+    free(acc->limbs);
+    acc->limbs = limbs;
+    acc->cap = cap;
+}
+
+void
+number_acc_add(NumberAcc *acc, Number a)
+{
+    if (a.size > acc->size) {
+        number_acc_reserve(acc, a.size);
+        memset(acc->limbs + acc->size, 0, (a.size - acc->size) * sizeof(UDWORD));
+        acc->size = a.size;
+    }
+    UDWORD *limbs = acc->limbs;
+    for (size_t i = 0; i < a.size; ++i) {
+        limbs[i] += a.words[i];
+    }
+}
+
+// Adds 'src' to 'dst'; 'src' is left untouched.
+void
+number_acc_merge(NumberAcc *dst, const NumberAcc *src)
+{
+    if (src->size > dst->size) {
+        number_acc_reserve(dst, src->size);
+        memset(dst->limbs + dst->size, 0, (src->size - dst->size) * sizeof(UDWORD));
+        dst->size = src->size;
+    }
+    UDWORD *limbs = dst->limbs;
+    for (size_t i = 0; i < src->size; ++i) {
+        limbs[i] += src->limbs[i];
+    }
+}
+
+// Propagates the carries and returns the sum. The accumulator keeps its value (with
+// every cell reduced to a single word), so more numbers may be added afterwards.
+Number
+number_acc_settle(NumberAcc *acc)
+{
+    // With at most 2^64 addends, each cell is at most 2^64 (2^64 - 1) = 2^128 - 2^64, so adding
+    // a carry below 2^64 cannot overflow it, and the carry out of it is below 2^64 again: the
+    // one out of the last cell fits in a word.
+    number_acc_reserve(acc, acc->size + 1);
+    UDWORD *limbs = acc->limbs;
+    UDWORD carry = 0;
+    size_t size = acc->size;
+    for (size_t i = 0; i < size; ++i) {
+        UDWORD v = limbs[i] + carry;
+        limbs[i] = (UWORD) v;
+        carry = v >> 64;
+    }
+    if (carry) {
+        limbs[size++] = carry;
+    }
+    while (size && !limbs[size - 1]) {
+        --size;
+    }
+    acc->size = size;
+
+    UWORD *words = xmalloc2(size, sizeof(UWORD));
+    for (size_t i = 0; i < size; ++i) {
+        words[i] = limbs[i];
+    }
+    return (Number) {words, size};
+}
+
+void
+number_acc_free(NumberAcc *acc)
+{
+    free(acc->limbs);
+}
+
+typedef struct {
+    const Number *nums;
+    size_t n;
+    NumberAcc acc;
+} NumberSumTask;
+
+static
+void *
+number_sum_worker(void *arg)
+{
+    NumberSumTask *task = arg;
+    for (size_t i = 0; i < task->n; ++i) {
+        number_acc_add(&task->acc, task->nums[i]);
+    }
+    return NULL;
+}
+
+// Sums 'n' numbers, splitting them across 'nthreads' threads; every thread fills its own
+// accumulator, and the partial sums are merged and settled once at the end.
+Number
+number_sum_parallel(const Number *nums, size_t n, unsigned nthreads)
+{
+    if (!nthreads) {
+        nthreads = 1;
+    }
+    if (nthreads > n) {
+        nthreads = n ? n : 1;
+    }
+    NumberSumTask *tasks = xmalloc2(nthreads, sizeof(NumberSumTask));
+    pthread_t *threads = xmalloc2(nthreads, sizeof(pthread_t));
+
+    size_t per_thread = n / nthreads;
+    size_t rem = n % nthreads;
+    for (unsigned i = 0; i < nthreads; ++i) {
+        size_t cnt = per_thread + (i < rem);
+        tasks[i] = (NumberSumTask) {nums, cnt, number_acc_new()};
+        nums += cnt;
+    }
+    // the first slice is summed by the calling thread.
+    unsigned nspawned = 1;
+    for (; nspawned < nthreads; ++nspawned) {
+        if (pthread_create(&threads[nspawned], NULL, number_sum_worker, &tasks[nspawned]) != 0) {
+            break;
+        }
+    }
+    number_sum_worker(&tasks[0]);
+    // whatever could not get a thread is summed here as well.
+    for (unsigned i = nspawned; i < nthreads; ++i) {
+        number_sum_worker(&tasks[i]);
+    }
+    for (unsigned i = 1; i < nspawned; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+
+    for (unsigned i = 1; i < nthreads; ++i) {
+        number_acc_merge(&tasks[0].acc, &tasks[i].acc);
+        number_acc_free(&tasks[i].acc);
+    }
+    Number r = number_acc_settle(&tasks[0].acc);
+    number_acc_free(&tasks[0].acc);
+
+    free(threads);
+    free(tasks);
+    return r;
+}
+
+//-----------------------------------------------------------------------------
+// Reference implementations in portable C (no asm, nothing wider than 64 bits), used by
+// 'bignum check' and 'bignum bench' to verify the kernels above. Slow on purpose.
+
+static
+size_t
+ref_norm(const UWORD *w, size_t n)
+{
+    while (n && !w[n - 1]) {
+        --n;
+    }
+    return n;
+}
+
+// 'dst' needs MAX(a.size, b.size) + 1 words.
+static
+size_t
+ref_add(UWORD *dst, Number a, Number b)
+{
+    const size_t n = MAX(a.size, b.size);
+    UWORD carry = 0;
+    for (size_t i = 0; i < n; ++i) {
+        UWORD x = i < a.size ? a.words[i] : 0;
+        UWORD y = i < b.size ? b.words[i] : 0;
+        UWORD s = x + y;
+        UWORD c = s < x;
+        UWORD t = s + carry;
+        c |= t < s;
+        dst[i] = t;
+        carry = c;
+    }
+    dst[n] = carry;
+    return ref_norm(dst, n + 1);
+}
+
+// 'dst' needs a.size words; assumes a >= b.
+static
+size_t
+ref_sub(UWORD *dst, Number a, Number b)
+{
+    UWORD borrow = 0;
+    for (size_t i = 0; i < a.size; ++i) {
+        UWORD x = a.words[i];
+        UWORD y = i < b.size ? b.words[i] : 0;
+        UWORD d = x - y;
+        UWORD c = x < y;
+        UWORD e = d - borrow;
+        c |= d < borrow;
+        dst[i] = e;
+        borrow = c;
+    }
+    return ref_norm(dst, a.size);
+}
+
+static
+int
+ref_cmp(Number a, Number b)
+{
+    size_t na = ref_norm(a.words, a.size);
+    size_t nb = ref_norm(b.words, b.size);
+    if (na != nb) {
+        return na > nb ? 1 : -1;
+    }
+    for (size_t i = na; i--;) {
+        if (a.words[i] != b.words[i]) {
+            return a.words[i] > b.words[i] ? 1 : -1;
+        }
+    }
+    return 0;
+}
+
+// (hi, lo) = x * y
+static
+void
+ref_mul_1x1(UWORD x, UWORD y, UWORD *hi, UWORD *lo)
+{
+    const UWORD m = 0xFFFFFFFF;
+    UWORD ll = (x & m) * (y & m);
+    UWORD lh = (x & m) * (y >> 32);
+    UWORD hl = (x >> 32) * (y & m);
+    UWORD hh = (x >> 32) * (y >> 32);
+    UWORD mid = (ll >> 32) + (lh & m) + (hl & m);
+    *lo = (ll & m) | (mid << 32);
+    *hi = hh + (lh >> 32) + (hl >> 32) + (mid >> 32);
+}
+
+// 'dst' needs a.size + b.size words.
+static
+size_t
+ref_mul(UWORD *dst, Number a, Number b)
+{
+    for (size_t i = 0; i < a.size + b.size; ++i) {
+        dst[i] = 0;
+    }
+    for (size_t i = 0; i < a.size; ++i) {
+        UWORD carry = 0;
+        for (size_t j = 0; j < b.size; ++j) {
+            UWORD hi, lo;
+            ref_mul_1x1(a.words[i], b.words[j], &hi, &lo);
+            lo += carry;
+            hi += lo < carry;
+            dst[i + j] += lo;
+            hi += dst[i + j] < lo;
+            carry = hi;
+        }
+        dst[i + b.size] = carry;
+    }
+    return ref_norm(dst, a.size + b.size);
+}
+
+static const char ref_digits[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+
+static
+unsigned
+ref_digit_value(char c)
+{
+    for (unsigned i = 0; i < 36; ++i) {
+        if (c == ref_digits[i] || (i >= 10 && c == ref_digits[i] - 'A' + 'a')) {
+            return i;
+        }
+    }
+    abort();
+}
+
+// 'dst' needs calc_ndigits(radix, ns) words; 's' must consist of valid digits only.
+static
+size_t
+ref_parse(UWORD *dst, const char *s, size_t ns, unsigned radix)
+{
+    size_t size = 0;
+    for (size_t k = 0; k < ns; ++k) {
+        UWORD carry = ref_digit_value(s[k]);
+        for (size_t i = 0; i < size; ++i) {
+            UWORD hi, lo;
+            ref_mul_1x1(dst[i], radix, &hi, &lo);
+            lo += carry;
+            hi += lo < carry;
+            dst[i] = lo;
+            carry = hi;
+        }
+        if (carry) {
+            dst[size++] = carry;
+        }
+    }
+    return size;
+}
+
+// Same contract as 'number_format'.
+static
+size_t
+ref_format(Number a, unsigned radix, char *out, UWORD *scratch)
+{
+    size_t size = ref_norm(a.words, a.size);
+    for (size_t i = 0; i < size; ++i) {
+        scratch[i] = a.words[i];
+    }
+    size_t n = 0;
+    do {
+        UWORD rem = 0;
+        for (size_t i = size; i--;) {
+            UWORD hi = (rem << 32) | (scratch[i] >> 32);
+            UWORD qh = hi / radix;
+            rem = hi % radix;
+            UWORD lo = (rem << 32) | (scratch[i] & 0xFFFFFFFF);
+            UWORD ql = lo / radix;
+            rem = lo % radix;
+            scratch[i] = (qh << 32) | ql;
+        }
+        out[n++] = ref_digits[rem];
+        size = ref_norm(scratch, size);
+    } while (size);
+
+    for (size_t i = 0; i < n / 2; ++i) {
+        char tmp = out[i];
+        out[i] = out[n - i - 1];
+        out[n - i - 1] = tmp;
+    }
+    return n;
+}
+
+//-----------------------------------------------------------------------------
+// 'bignum check' and 'bignum bench'
+
+static UWORD rng_state = 88172645463325252UL;
+
+static
+UWORD
+rng_next(void)
+{
+    // xorshift64*
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return rng_state * 2685821657736338717UL;
+}
+
+// Fills 'w' with 'n' random words, the top one nonzero. Runs of zero and all-ones words are
+// common, as those are what long carry and borrow chains are made of.
+static
+void
+random_words(UWORD *w, size_t n)
+{
+    const unsigned mode = rng_next() % 4;
+    for (size_t i = 0; i < n; ++i) {
+        unsigned pick = mode == 3 ? rng_next() % 3 : mode;
+        switch (pick) {
+        case 0:  w[i] = rng_next(); break;
+        case 1:  w[i] = ~(UWORD) 0; break;
+        default: w[i] = rng_next() % 4 ? 0 : rng_next(); break;
+        }
+    }
+    if (n && !w[n - 1]) {
+        w[n - 1] = 1 + rng_next() % 1000;
+    }
+}
+
+static
+bool
+words_equal(const UWORD *a, size_t na, const UWORD *b, size_t nb)
+{
+    return na == nb && (!na || memcmp(a, b, na * sizeof(UWORD)) == 0);
+}
+
+static
+void
+check_dump(const char *name, Number a)
+{
+    fprintf(stderr, "%s =", name);
+    for (size_t i = a.size; i--;) {
+        fprintf(stderr, " %016lx", a.words[i]);
+    }
+    fputc('\n', stderr);
+}
+
+static
+int
+check_fail(const char *what, Number a, Number b)
+{
+    fprintf(stderr, "check: %s mismatch (operand sizes %zu and %zu)\n", what, a.size, b.size);
+    check_dump("a", a);
+    check_dump("b", b);
+    return 1;
+}
+
+// Same for the conversions to and from text, which take one operand and a radix.
+static
+int
+check_fail_radix(const char *what, Number a, unsigned radix)
+{
+    fprintf(stderr, "check: %s mismatch in radix %u (operand size %zu)\n", what, radix, a.size);
+    check_dump("a", a);
+    return 1;
+}
+
+static
+size_t
+random_size(void)
+{
+    switch (rng_next() % 8) {
+    case 0:  return 0;
+    case 1:  return 1;
+    case 2:  return 2 + rng_next() % 3;
+    case 7:  return rng_next() % 300;
+    default: return rng_next() % 40;
+    }
+}
+
+static
+int
+check_fail_sum(const char *what, size_t n, unsigned nthreads, Number sum, Number ref)
+{
+    fprintf(stderr, "check: %s mismatch (%zu addends, %u threads)\n", what, n, nthreads);
+    check_dump("sum", sum);
+    check_dump("ref", ref);
+    return 1;
+}
+
+// Sums of many numbers, through number_sum_parallel() with one and several threads, and
+// through an accumulator that is settled halfway and then added to, against a chain of
+// words_add(). Some rounds add nothing but all-ones words, which fills the cells fastest.
+static
+int
+check_sum(void)
+{
+    enum { MAXN = 20000, MAXLEN = 64, ROUNDS = 24 };
+    Number *nums = xmalloc2(MAXN, sizeof(Number));
+    UWORD *pool = xmalloc2((size_t) MAXN * MAXLEN, sizeof(UWORD));
+    UWORD *wref = xmalloc2(MAXLEN + 2, sizeof(UWORD));
+    static const size_t small_n[] = {0, 1, 2, 7};
+
+    for (int round = 0; round < ROUNDS; ++round) {
+        const size_t n = round < 4 ? small_n[round] : 100 + rng_next() % (MAXN - 100);
+        const unsigned kind = round % 3; // mixed lengths, one length, or all ones
+        const size_t len = 1 + rng_next() % MAXLEN;
+        size_t nref = 0;
+        for (size_t i = 0; i < n; ++i) {
+            UWORD *w = pool + i * MAXLEN;
+            const size_t nw = kind == 0 ? rng_next() % (MAXLEN + 1) : len;
+            if (kind == 2) {
+                memset(w, 0xff, nw * sizeof(UWORD));
+            } else {
+                random_words(w, nw);
+            }
+            nums[i] = (Number) {w, nw};
+            nref = words_add(wref, (Number) {wref, nref}, nums[i]);
+        }
+        const Number ref = {wref, nref};
+
+        for (unsigned nthreads = 1; nthreads <= 4; nthreads += 3) {
+            Number sum = number_sum_parallel(nums, n, nthreads);
+            if (!words_equal(sum.words, sum.size, ref.words, ref.size)) {
+                return check_fail_sum("sum", n, nthreads, sum, ref);
+            }
+            number_free(sum);
+        }
+
+        NumberAcc acc = number_acc_new();
+        for (size_t i = 0; i < n / 2; ++i) {
+            number_acc_add(&acc, nums[i]);
+        }
+        number_free(number_acc_settle(&acc));
+        for (size_t i = n / 2; i < n; ++i) {
+            number_acc_add(&acc, nums[i]);
+        }
+        Number sum = number_acc_settle(&acc);
+        number_acc_free(&acc);
+        if (!words_equal(sum.words, sum.size, ref.words, ref.size)) {
+            return check_fail_sum("settled accumulator", n, 1, sum, ref);
+        }
+        number_free(sum);
+    }
+
+    free(nums);
+    free(pool);
+    free(wref);
+    return 0;
+}
+
+// Runs every kernel on random operands and compares the results with the reference, then
+// checks the summation.
+static
+int
+bignum_check(unsigned long iters)
+{
+    enum { MAXN = 300 };
+    UWORD *wa = xmalloc2(MAXN, sizeof(UWORD));
+    UWORD *wb = xmalloc2(MAXN, sizeof(UWORD));
+    UWORD *r1 = xmalloc2(2 * MAXN + 1, sizeof(UWORD));
+    UWORD *r2 = xmalloc2(2 * MAXN + 1, sizeof(UWORD));
+    UWORD *r3 = xmalloc2(2 * MAXN + 1, sizeof(UWORD));
+    UWORD *scratch = xmalloc2(10 * MAXN + 1024, sizeof(UWORD));
+    const size_t ndigits = (MAXN + 1) * 65;
+    char *s1 = xmalloc(ndigits);
+    char *s2 = xmalloc(ndigits);
+    const size_t threshold = mul_karatsuba_threshold;
+
+    for (unsigned long it = 0; it < iters; ++it) {
+        size_t na = random_size();
+        size_t nb = random_size();
+        random_words(wa, na);
+        random_words(wb, nb);
+        if (rng_next() % 8 == 0 && na >= nb) {
+            // same length and top word, so that comparison has to look further.
+            if ((nb = na)) {
+                memcpy(wb, wa, na * sizeof(UWORD));
+                wb[rng_next() % nb] ^= rng_next() % 2 ? 1 : rng_next();
+                if (!wb[nb - 1]) {
+                    wb[nb - 1] = 1;
+                }
+            }
+        }
+        Number a = {wa, na};
+        Number b = {wb, nb};
+
+        if (number_cmp(a, b) != ref_cmp(a, b) || number_cmp(b, a) != ref_cmp(b, a) ||
+            number_cmp(a, a) != 0)
+        {
+            return check_fail("cmp", a, b);
+        }
+
+        size_t n1 = words_add(r1, a, b);
+        size_t n2 = ref_add(r2, a, b);
+        if (!words_equal(r1, n1, r2, n2)) {
+            return check_fail("add", a, b);
+        }
+
+        Number big = ref_cmp(a, b) >= 0 ? a : b;
+        Number small = ref_cmp(a, b) >= 0 ? b : a;
+        n1 = words_sub(r1, big, small);
+        n2 = ref_sub(r2, big, small);
+        if (!words_equal(r1, n1, r2, n2)) {
+            return check_fail("sub", big, small);
+        }
+
+        // small thresholds make Karatsuba kick in on small operands too.
+        mul_karatsuba_threshold = 8 + rng_next() % 40;
+        n1 = words_mul(r1, a, b, scratch);
+        mul_karatsuba_threshold = threshold;
+        n2 = ref_mul(r2, a, b);
+        if (!words_equal(r1, n1, r2, n2)) {
+            return check_fail("mul", a, b);
+        }
+
+        if (b.size) {
+            size_t nq, nr;
+            words_divmod(r1, &nq, r3, &nr, a, b, scratch);
+            n2 = ref_mul(r2, (Number) {r1, nq}, b);
+            UWORD *sum = scratch + a.size + b.size + 1;
+            size_t nsum = ref_add(sum, (Number) {r2, n2}, (Number) {r3, nr});
+            if (!words_equal(sum, nsum, a.words, a.size) ||
+                ref_cmp((Number) {r3, nr}, b) >= 0)
+            {
+                return check_fail("divmod", a, b);
+            }
+        }
+
+        if (it % 4 == 0) {
+            Number g1 = number_gcd(a, b);
+            Number g2 = number_gcd_binary(a, b);
+            bool ok = words_equal(g1.words, g1.size, g2.words, g2.size);
+            if (ok && b.size) {
+                Number inv;
+                bool invertible = number_invmod(a, b, &inv);
+                bool coprime = g1.size == 1 && g1.words[0] == 1;
+                if (b.size == 1 && b.words[0] == 1) {
+                    ok = invertible && !inv.size;
+                } else {
+                    ok = invertible == coprime;
+                }
+                if (ok && invertible && inv.size) {
+                    // a * inv = 1 (mod b), and inv < b
+                    Number prod = number_mul(a, inv);
+                    Number q, rem;
+                    number_divmod(prod, b, &q, &rem);
+                    ok = rem.size == 1 && rem.words[0] == 1 && number_cmp(inv, b) < 0;
+                    number_free(prod);
+                    number_free(q);
+                    number_free(rem);
+                }
+                if (invertible) {
+                    number_free(inv);
+                }
+            }
+            number_free(g1);
+            number_free(g2);
+            if (!ok) {
+                return check_fail("gcd/invmod", a, b);
+            }
+        }
+
+        unsigned radix = 2 + rng_next() % 35;
+        size_t ns1 = number_format(a, radix, s1, scratch);
+        size_t ns2 = ref_format(a, radix, s2, scratch);
+        if (ns1 != ns2 || memcmp(s1, s2, ns1) != 0) {
+            return check_fail_radix("format", a, radix);
+        }
+        for (size_t i = 0; i < ns2; ++i) {
+            if (rng_next() % 2 && s2[i] >= 'A') {
+                s2[i] += 'a' - 'A';
+            }
+        }
+        n1 = words_parse(r1, s2, ns2, radix);
+        n2 = ref_parse(r2, s2, ns2, radix);
+        if (!words_equal(r1, n1, r2, n2) || !words_equal(r1, n1, a.words, a.size)) {
+            return check_fail_radix("parse", a, radix);
+        }
+    }
+
+    free(wa);
+    free(wb);
+    free(r1);
+    free(r2);
+    free(r3);
+    free(scratch);
+    free(s1);
+    free(s2);
+    if (check_sum()) {
+        return 1;
+    }
+    fprintf(stderr, "check: %lu iterations OK\n", iters);
+    return 0;
+}
+
+static
+double
+now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+enum { BENCH_MIN_NS = 20 * 1000 * 1000 };
+
+// Runs 'Stmt_' often enough for the measurement to take BENCH_MIN_NS, then stores the time
+// one run took in 'Result_'.
+#define BENCH(Result_, Stmt_) \
+    do { \
+        for (size_t reps_ = 1;; reps_ *= 2) { \
+            double t0_ = now_ns(); \
+            for (size_t r_ = 0; r_ < reps_; ++r_) { \
+                Stmt_; \
+            } \
+            double dt_ = now_ns() - t0_; \
+            if (dt_ >= BENCH_MIN_NS) { \
+                Result_ = dt_ / reps_; \
+                break; \
+            } \
+        } \
+    } while (0)
+
+static
+void
+bench_verify(bool ok, const char *what, size_t n)
+{
+    if (!ok) {
+        fprintf(stderr, "bench: %s result differs from the reference at %zu limbs\n", what, n);
+        exit(1);
+    }
+}
+
+// Times the kernels at operand sizes from 1 to 'maxn' words (on a log scale, four steps per
+// decade) and prints nanoseconds per limb; every result is checked against the reference.
+// Quadratic operations (schoolbook multiplication, parse, print) are skipped above 'quadmax'.
+// Then finds the size from which one level of Karatsuba beats schoolbook multiplication, times
+// GCD (Lehmer and binary) and modular inverse up to 'quadmax', and the summation of many
+// numbers of up to 'maxn' (at most 65536) words.
+static
+int
+bignum_bench(size_t maxn, size_t quadmax)
+{
+    volatile size_t sink = 0;
+
+    printf("%9s %9s %9s %9s %9s %9s %9s %9s   (ns/limb)\n",
+           "limbs", "add", "sub", "cmp", "mul/sch", "mul", "parse", "print");
+
+    size_t prev_n = 0;
+    for (double x = 1; (size_t) (x + 0.5) <= maxn; x *= 1.778279410038923) {
+        const size_t n = x + 0.5;
+        if (n == prev_n) {
+            continue;
+        }
+        prev_n = n;
+
+        UWORD *wa = xmalloc2(n, sizeof(UWORD));
+        UWORD *wb = xmalloc2(n, sizeof(UWORD));
+        UWORD *r1 = xmalloc2(2 * n + 1, sizeof(UWORD));
+        UWORD *r2 = xmalloc2(2 * n + 1, sizeof(UWORD));
+        UWORD *scratch = xmalloc2(10 * n + 1024, sizeof(UWORD));
+        for (size_t i = 0; i < n; ++i) {
+            wa[i] = rng_next();
+            wb[i] = rng_next();
+        }
+        wa[n - 1] |= (UWORD) 1 << 63;
+        wb[n - 1] &= ~((UWORD) 1 << 63);
+        Number a = {wa, n};
+        Number b = {wb, n};
+        double t_add, t_sub, t_cmp, t_sch = -1, t_mul, t_parse = -1, t_print = -1;
+        size_t nr;
+
+        BENCH(t_add, sink += words_add(r1, a, b));
+        bench_verify(words_equal(r1, words_add(r1, a, b), r2, ref_add(r2, a, b)), "add", n);
+
+        BENCH(t_sub, sink += words_sub(r1, a, b));
+        bench_verify(words_equal(r1, words_sub(r1, a, b), r2, ref_sub(r2, a, b)), "sub", n);
+
+        memcpy(r1, wa, n * sizeof(UWORD));
+        BENCH(t_cmp, sink += number_cmp(a, (Number) {r1, n}));
+        bench_verify(number_cmp(a, b) == ref_cmp(a, b), "cmp", n);
+
+        const size_t threshold = mul_karatsuba_threshold;
+        if (n <= quadmax) {
+            mul_karatsuba_threshold = SIZE_MAX;
+            BENCH(t_sch, sink += words_mul(r1, a, b, scratch));
+            mul_karatsuba_threshold = threshold;
+            bench_verify(words_equal(r1, words_mul(r1, a, b, scratch), r2, ref_mul(r2, a, b)),
+                         "mul", n);
+        }
+        BENCH(t_mul, sink += words_mul(r1, a, b, scratch));
+
+        if (n <= quadmax) {
+            char *digits = xmalloc(number_format_size(a, 10));
+            char *digits2 = xmalloc(number_format_size(a, 10));
+            size_t ndigits = 0;
+            BENCH(t_print, ndigits = number_format(a, 10, digits, scratch));
+            size_t ndigits2 = ref_format(a, 10, digits2, scratch);
+            bench_verify(ndigits == ndigits2 && memcmp(digits, digits2, ndigits) == 0,
+                         "print", n);
+
+            BENCH(t_parse, nr = words_parse(r1, digits, ndigits, 10));
+            bench_verify(words_equal(r1, nr, wa, n), "parse", n);
+            free(digits);
+            free(digits2);
+        }
+
+        printf("%9zu %9.3f %9.3f %9.3f ", n, t_add / n, t_sub / n, t_cmp / n);
+        if (t_sch >= 0) {
+            printf("%9.2f ", t_sch / n);
+        } else {
+            printf("%9s ", "-");
+        }
+        printf("%9.2f ", t_mul / n);
+        if (t_parse >= 0) {
+            printf("%9.2f %9.2f\n", t_parse / n, t_print / n);
+        } else {
+            printf("%9s %9s\n", "-", "-");
+        }
+        fflush(stdout);
+
+        free(wa);
+        free(wb);
+        free(r1);
+        free(r2);
+        free(scratch);
+    }
+
+    // Karatsuba crossover: the smallest size from which one level of Karatsuba (on top of
+    // schoolbook) is consistently faster than schoolbook alone.
+    const size_t threshold = mul_karatsuba_threshold;
+    size_t crossover = 0;
+    for (size_t n = 8; n <= 256 && n <= maxn; n += n < 32 ? 2 : n < 64 ? 4 : 16) {
+        UWORD *wa = xmalloc2(n, sizeof(UWORD));
+        UWORD *wb = xmalloc2(n, sizeof(UWORD));
+        UWORD *r1 = xmalloc2(2 * n, sizeof(UWORD));
+        UWORD *scratch = xmalloc2(10 * n + 1024, sizeof(UWORD));
+        for (size_t i = 0; i < n; ++i) {
+            wa[i] = rng_next();
+            wb[i] = rng_next() | 1;
+        }
+        double t_sch, t_kar;
+        mul_karatsuba_threshold = SIZE_MAX;
+        BENCH(t_sch, mul_any(r1, wa, n, wb, n, scratch));
+        mul_karatsuba_threshold = n;
+        BENCH(t_kar, mul_any(r1, wa, n, wb, n, scratch));
+        if (t_kar < t_sch) {
+            if (!crossover) {
+                crossover = n;
+            }
+        } else {
+            crossover = 0;
+        }
+        free(wa);
+        free(wb);
+        free(r1);
+        free(scratch);
+    }
+    mul_karatsuba_threshold = threshold;
+
+    if (crossover) {
+        printf("Karatsuba beats schoolbook from %zu limbs (mul_karatsuba_threshold is %zu)\n",
+               crossover, mul_karatsuba_threshold);
+    } else {
+        printf("Karatsuba does not beat schoolbook up to %zu limbs\n", maxn < 256 ? maxn : 256);
+    }
+
+    // GCD: Lehmer against the binary algorithm; both are quadratic.
+    printf("\n%9s %12s %12s %12s   (us)\n", "limbs", "gcd", "gcd/binary", "invmod");
+    prev_n = 0;
+    for (double x = 1; (size_t) (x + 0.5) <= quadmax && (size_t) (x + 0.5) <= maxn;
+         x *= 1.778279410038923)
+    {
+        const size_t n = x + 0.5;
+        if (n == prev_n) {
+            continue;
+        }
+        prev_n = n;
+
+        UWORD *wa = xmalloc2(n, sizeof(UWORD));
+        UWORD *wb = xmalloc2(n, sizeof(UWORD));
+        for (size_t i = 0; i < n; ++i) {
+            wa[i] = rng_next();
+            wb[i] = rng_next();
+        }
+        wa[n - 1] |= 1;
+        wb[0] |= 1;
+        Number a = {wa, n};
+        Number b = {wb, n};
+        Number g1, g2, inv = {NULL, 0};
+        double t_gcd, t_bin, t_inv;
+        BENCH(t_gcd, number_free(g1 = number_gcd(a, b)));
+        BENCH(t_bin, number_free(g2 = number_gcd_binary(a, b)));
+        g1 = number_gcd(a, b);
+        g2 = number_gcd_binary(a, b);
+        bench_verify(words_equal(g1.words, g1.size, g2.words, g2.size), "gcd", n);
+        if (g1.size == 1 && g1.words[0] == 1) {
+            BENCH(t_inv, number_invmod(a, b, &inv); number_free(inv));
+            printf("%9zu %12.2f %12.2f %12.2f\n", n, t_gcd / 1e3, t_bin / 1e3, t_inv / 1e3);
+        } else {
+            printf("%9zu %12.2f %12.2f %12s\n", n, t_gcd / 1e3, t_bin / 1e3, "-");
+        }
+        fflush(stdout);
+        number_free(g1);
+        number_free(g2);
+        free(wa);
+        free(wb);
+    }
+
+    // Summation of many numbers: the deferred-carry accumulator on one thread and on every CPU,
+    // against a chain of words_add().
+    const long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    const unsigned nthreads = ncpu > 1 ? ncpu : 1;
+    char acc_n[16];
+    snprintf(acc_n, sizeof(acc_n), "acc/%u", nthreads);
+    printf("\n%9s %9s %9s %9s %9s   (ns/limb)\n", "limbs", "addends", "chain", "acc/1", acc_n);
+    prev_n = 0;
+    for (double x = 1; (size_t) (x + 0.5) <= maxn && (size_t) (x + 0.5) <= 65536;
+         x *= 1.778279410038923)
+    {
+        const size_t n = x + 0.5;
+        if (n == prev_n) {
+            continue;
+        }
+        prev_n = n;
+
+        // about 4M words in all
+        const size_t count = MAX(((size_t) 1 << 22) / n, 64);
+        UWORD *pool = xmalloc2(count * n, sizeof(UWORD));
+        Number *nums = xmalloc2(count, sizeof(Number));
+        for (size_t i = 0; i < count; ++i) {
+            nums[i] = (Number) {pool + i * n, n};
+            for (size_t j = 0; j < n; ++j) {
+                nums[i].words[j] = rng_next();
+            }
+            nums[i].words[n - 1] |= 1;
+        }
+        UWORD *chain = xmalloc2(n + 2, sizeof(UWORD));
+        size_t nchain = 0;
+        double t_chain, t_acc1, t_accn;
+        BENCH(t_chain, {
+            nchain = 0;
+            for (size_t i = 0; i < count; ++i) {
+                nchain = words_add(chain, (Number) {chain, nchain}, nums[i]);
+            }
+        });
+        Number sum = {NULL, 0};
+        BENCH(t_acc1, number_free(sum = number_sum_parallel(nums, count, 1)));
+        BENCH(t_accn, number_free(sum = number_sum_parallel(nums, count, nthreads)));
+        sum = number_sum_parallel(nums, count, nthreads);
+        bench_verify(words_equal(sum.words, sum.size, chain, nchain), "sum", n);
+        number_free(sum);
+
+        const double limbs = (double) count * n;
+        printf("%9zu %9zu %9.3f %9.3f %9.3f\n",
+               n, count, t_chain / limbs, t_acc1 / limbs, t_accn / limbs);
+        fflush(stdout);
+        free(chain);
+        free(nums);
+        free(pool);
+    }
+    (void) sink;
+    return 0;
+}
+
+//-----------------------------------------------------------------------------
+// RPN calculator; reads whitespace-separated tokens from stdin:
+//
+//   <decimal digits>   push a number
+//   add sub mul        pop b, pop a, push a OP b ('sub' requires a >= b)
+//   divmod             pop b, pop a, push a / b, push a % b
+//   gcd                pop b, pop a, push gcd(a, b)
+//   invmod             pop m, pop a, push the inverse of a modulo m
+//   cmp                pop b, pop a, print -1, 0 or 1
+//   print              pop a, print it in the output radix
+//   radix              pop r, make r (2..36, initially 10) the output radix
+//   dup drop swap      the usual
+//
+// Popped slots keep their buffers, and every operation computes its result into a spare
+// slot that is then swapped with a stack slot, so in the steady state nothing gets
+// allocated. Input and output go through large buffers and plain read/write.
+
+typedef struct {
+    Number num;
+    size_t cap;
+} RpnSlot;
+
+static RpnSlot *rpn_stack;
+static size_t rpn_size;
+static size_t rpn_nslots;
+
+static RpnSlot rpn_spare[2];
+static RpnSlot rpn_scratch;
+
+static unsigned rpn_radix = 10;
+static size_t rpn_ntoken;
+
+static char *rpn_out;
+static size_t rpn_out_len;
+static size_t rpn_out_cap = 64 * 1024;
+
+static
+void
+rpn_flush(void)
+{
+    for (size_t written = 0; written != rpn_out_len;) {
+        ssize_t w = write(1, rpn_out + written, rpn_out_len - written);
+        if (w < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("write");
+            exit(1);
+        }
+        written += w;
+    }
+    rpn_out_len = 0;
+}
+
+static
+char *
+rpn_out_reserve(size_t n)
+{
+    if (rpn_out_cap - rpn_out_len < n) {
+        rpn_flush();
+        if (rpn_out_cap < n) {
+            free(rpn_out);
+            rpn_out = xmalloc(n);
+            rpn_out_cap = n;
+        }
+    }
+    return rpn_out + rpn_out_len;
+}
+
+static
+void
+rpn_die(const char *msg)
+{
+    rpn_flush();
+    fprintf(stderr, "bignum: token %zu: %s\n", rpn_ntoken, msg);
+    exit(1);
+}
+
+// Makes sure 'slot' has room for 'n' words; the contents are not preserved.
+static
+void
+rpn_slot_reserve(RpnSlot *slot, size_t n)
+{
+    if (slot->cap < n) {
+        size_t cap = MAX(n, slot->cap * 2);
+        free(slot->num.words);
+        slot->num.words = xmalloc2(cap, sizeof(UWORD));
+        slot->cap = cap;
+    }
+}
+
+static inline
+void
+rpn_slot_swap(RpnSlot *a, RpnSlot *b)
 {
-    //number_dump(a);
-    Number a = read_num();
-    Number b = read_num();
-    printf("%d\n", number_cmp(a, b));
-    //number_print(a, 2);
+    RpnSlot tmp = *a;
+    *a = *b;
+    *b = tmp;
+}
+
+static
+RpnSlot *
+rpn_push(void)
+{
+    if (rpn_size == rpn_nslots) {
+        size_t nslots = rpn_nslots ? rpn_nslots * 2 : 64;
+        RpnSlot *stack = xcalloc(nslots, sizeof(RpnSlot));
+        if (rpn_nslots) {
+            memcpy(stack, rpn_stack, rpn_nslots * sizeof(RpnSlot));
+        }
+        free(rpn_stack);
+        rpn_stack = stack;
+        rpn_nslots = nslots;
+    }
+    return &rpn_stack[rpn_size++];
+}
+
+static inline
+void
+rpn_need(size_t n)
+{
+    if (rpn_size < n) {
+        rpn_die("stack underflow");
+    }
+}
+
+static
+void
+rpn_exec(const char *tok, size_t ntok)
+{
+    ++rpn_ntoken;
+
+    if (tok[0] >= '0' && tok[0] <= '9') {
+        for (size_t i = 1; i < ntok; ++i) {
+            if (tok[i] < '0' || tok[i] > '9') {
+                rpn_die("invalid number");
+            }
+        }
+        RpnSlot *slot = rpn_push();
+        rpn_slot_reserve(slot, calc_ndigits(10, ntok));
+        slot->num.size = words_parse(slot->num.words, tok, ntok, 10);
+        return;
+    }
+
+#define IS(S_) (ntok == sizeof(S_) - 1 && memcmp(tok, S_, sizeof(S_) - 1) == 0)
+
+    if (IS("add")) {
+        rpn_need(2);
+        RpnSlot *sa = &rpn_stack[rpn_size - 2];
+        RpnSlot *sb = &rpn_stack[rpn_size - 1];
+        RpnSlot *dst = &rpn_spare[0];
+        rpn_slot_reserve(dst, MAX(sa->num.size, sb->num.size) + 1);
+        dst->num.size = words_add(dst->num.words, sa->num, sb->num);
+        rpn_slot_swap(dst, sa);
+        --rpn_size;
+
+    } else if (IS("sub")) {
+        rpn_need(2);
+        RpnSlot *sa = &rpn_stack[rpn_size - 2];
+        RpnSlot *sb = &rpn_stack[rpn_size - 1];
+        if (number_cmp(sa->num, sb->num) < 0) {
+            rpn_die("sub: negative result");
+        }
+        // subtracting in place is fine.
+        sa->num.size = words_sub(sa->num.words, sa->num, sb->num);
+        --rpn_size;
+
+    } else if (IS("mul")) {
+        rpn_need(2);
+        RpnSlot *sa = &rpn_stack[rpn_size - 2];
+        RpnSlot *sb = &rpn_stack[rpn_size - 1];
+        RpnSlot *dst = &rpn_spare[0];
+        rpn_slot_reserve(dst, sa->num.size + sb->num.size);
+        rpn_slot_reserve(&rpn_scratch, mul_scratch_size(sa->num.size, sb->num.size));
+        dst->num.size = words_mul(dst->num.words, sa->num, sb->num, rpn_scratch.num.words);
+        rpn_slot_swap(dst, sa);
+        --rpn_size;
+
+    } else if (IS("divmod")) {
+        rpn_need(2);
+        RpnSlot *sa = &rpn_stack[rpn_size - 2];
+        RpnSlot *sb = &rpn_stack[rpn_size - 1];
+        Number a = sa->num;
+        Number b = sb->num;
+        if (!b.size) {
+            rpn_die("divmod: division by zero");
+        }
+        RpnSlot *q = &rpn_spare[0];
+        RpnSlot *r = &rpn_spare[1];
+        rpn_slot_reserve(q, a.size >= b.size ? a.size - b.size + 1 : 1);
+        rpn_slot_reserve(r, b.size);
+        rpn_slot_reserve(&rpn_scratch, a.size + b.size + 1);
+        words_divmod(q->num.words, &q->num.size, r->num.words, &r->num.size, a, b,
+                     rpn_scratch.num.words);
+        rpn_slot_swap(q, sa);
+        rpn_slot_swap(r, sb);
+
+    } else if (IS("gcd") || IS("invmod")) {
+        rpn_need(2);
+        RpnSlot *sa = &rpn_stack[rpn_size - 2];
+        Number a = sa->num;
+        Number b = rpn_stack[rpn_size - 1].num;
+        RpnSlot *dst = &rpn_spare[0];
+        rpn_slot_reserve(dst, MAX(a.size, b.size) + 1);
+        rpn_slot_reserve(&rpn_scratch, gcd_scratch_size(a.size, b.size));
+        if (IS("gcd")) {
+            dst->num.size = words_gcd(dst->num.words, a, b, rpn_scratch.num.words);
+        } else if (!words_invmod(dst->num.words, &dst->num.size, a, b, rpn_scratch.num.words)) {
+            rpn_die("invmod: not invertible");
+        }
+        rpn_slot_swap(dst, sa);
+        --rpn_size;
+
+    } else if (IS("cmp")) {
+        rpn_need(2);
+        int c = number_cmp(rpn_stack[rpn_size - 2].num, rpn_stack[rpn_size - 1].num);
+        rpn_size -= 2;
+        char *out = rpn_out_reserve(3);
+        if (c < 0) {
+            *out++ = '-';
+            ++rpn_out_len;
+        }
+        out[0] = c ? '1' : '0';
+        out[1] = '\n';
+        rpn_out_len += 2;
+
+    } else if (IS("print")) {
+        rpn_need(1);
+        Number a = rpn_stack[--rpn_size].num;
+        rpn_slot_reserve(&rpn_scratch, a.size);
+        char *out = rpn_out_reserve(number_format_size(a, rpn_radix) + 1);
+        size_t n = number_format(a, rpn_radix, out, rpn_scratch.num.words);
+        out[n] = '\n';
+        rpn_out_len += n + 1;
+
+    } else if (IS("radix")) {
+        rpn_need(1);
+        Number r = rpn_stack[--rpn_size].num;
+        if (r.size != 1 || r.words[0] < 2 || r.words[0] > 36) {
+            rpn_die("radix: must be in range 2..36");
+        }
+        rpn_radix = r.words[0];
+
+    } else if (IS("dup")) {
+        rpn_need(1);
+        RpnSlot *dst = rpn_push();
+        Number a = dst[-1].num;
+        rpn_slot_reserve(dst, a.size);
+        if (a.size) {
+            memcpy(dst->num.words, a.words, a.size * sizeof(UWORD));
+        }
+        dst->num.size = a.size;
+
+    } else if (IS("drop")) {
+        rpn_need(1);
+        --rpn_size;
+
+    } else if (IS("swap")) {
+        rpn_need(2);
+        rpn_slot_swap(&rpn_stack[rpn_size - 2], &rpn_stack[rpn_size - 1]);
+
+    } else {
+        rpn_die("unknown command");
+    }
+
+#undef IS
+}
+
+static inline
+bool
+is_space(char c)
+{
+    return c == ' ' || c == '\n' || c == '\t' || c == '\r';
+}
+
+static
+int
+rpn_run(void)
+{
+    size_t cap = 64 * 1024;
+    char *buf = xmalloc(cap);
+    size_t len = 0;
+    size_t pos = 0;
+    bool eof = false;
+
+    rpn_out = xmalloc(rpn_out_cap);
+
+    while (1) {
+        while (pos != len && is_space(buf[pos])) {
+            ++pos;
+        }
+        size_t end = pos;
+        while (end != len && !is_space(buf[end])) {
+            ++end;
+        }
+        if (end == len && !eof) {
+            // the token might continue past what has been read so far.
+            memmove(buf, buf + pos, len - pos);
+            len -= pos;
+            pos = 0;
+            if (len == cap) {
+                char *new_buf = xmalloc2(cap, 2);
+                memcpy(new_buf, buf, len);
+                free(buf);
+                buf = new_buf;
+                cap *= 2;
+            }
+            ssize_t r = read(0, buf + len, cap - len);
+            if (r < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                perror("read");
+                return 1;
+            }
+            if (r == 0) {
+                eof = true;
+            }
+            len += r;
+            continue;
+        }
+        if (pos == end) {
+            break;
+        }
+        rpn_exec(buf + pos, end - pos);
+        pos = end;
+    }
+
+    rpn_flush();
+    return 0;
+}
+
+static
+void
+usage(void)
+{
+    fputs("USAGE: bignum              RPN calculator on stdin\n"
+          "       bignum check [ITERATIONS]\n"
+          "       bignum bench [MAXLIMBS [QUADMAXLIMBS]]\n", stderr);
+    exit(2);
+}
+
+int
+main(int argc, char **argv)
+{
+    if (argc == 1) {
+        return rpn_run();
+    }
+    if (strcmp(argv[1], "check") == 0 && argc <= 3) {
+        return bignum_check(argc == 3 ? strtoul(argv[2], NULL, 10) : 100000);
+    }
+    if (strcmp(argv[1], "bench") == 0 && argc <= 4) {
+        size_t maxn = argc >= 3 ? strtoul(argv[2], NULL, 10) : 1000000;
+        size_t quadmax = argc >= 4 ? strtoul(argv[3], NULL, 10) : 4096;
+        return bignum_bench(maxn, quadmax);
+    }
+    usage();
 }
@@ -0,0 +1,670 @@
+// Load generator for epoll_et_srv: echo round trips over many connections, with latency
+// recorded in a log-linear (HDR-style) histogram.
+//
+// Compile with:
+//   gcc -O2 epoll_et_load.c -o epoll_et_load
+// (needs glibc 2.35+ and Linux 5.11+ for epoll_pwait2)
+#define _GNU_SOURCE
+#include <sys/epoll.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <sys/time.h>
+
+static void * xmalloc(size_t nelems, size_t elemsz)
+{
+    size_t n = nelems * elemsz;
+    void *r = malloc(n);
+    if (!r && n) {
+        fprintf(stderr, "Out of memory.\n");
+        abort();
+    }
+    return r;
+}
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static uint64_t rng_state = 88172645463325252ull;
+
+static uint64_t rng_next(void)
+{
+    uint64_t x = rng_state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return rng_state = x;
+}
+
+//-----------------------------------------------------------------------------
+// histogram
+//
+// Values below 2^HIST_SUB_BITS have a bucket each; above that, every power of two is split
+// into 2^HIST_SUB_BITS buckets, so a bucket is never wider than 1/128 of its values.
+
+enum { HIST_SUB_BITS = 7 };
+enum { HIST_NBUCKETS = (64 - HIST_SUB_BITS + 1) << HIST_SUB_BITS };
+
+typedef struct {
+    uint64_t counts[HIST_NBUCKETS];
+    uint64_t total;
+    uint64_t max;
+} Hist;
+
+static inline unsigned hist_index(uint64_t v)
+{
+    if (v < (1u << HIST_SUB_BITS)) {
+        return v;
+    }
+    unsigned shift = 63 - __builtin_clzll(v) - HIST_SUB_BITS;
+    return ((shift + 1) << HIST_SUB_BITS) + (unsigned) (v >> shift) - (1u << HIST_SUB_BITS);
+}
+
+// Returns the largest value that falls into bucket 'i'.
+static uint64_t hist_bucket_max(unsigned i)
+{
+    if (i < (1u << HIST_SUB_BITS)) {
+        return i;
+    }
+    unsigned shift = (i >> HIST_SUB_BITS) - 1;
+    uint64_t m = (i & ((1u << HIST_SUB_BITS) - 1)) | (1u << HIST_SUB_BITS);
+    return (m << shift) + ((UINT64_C(1) << shift) - 1);
+}
+
+static inline void hist_record(Hist *h, uint64_t v)
+{
+    ++h->counts[hist_index(v)];
+    ++h->total;
+    if (v > h->max) {
+        h->max = v;
+    }
+}
+
+// Returns the value below or at which the fraction 'q' of the recorded values lie.
+static uint64_t hist_quantile(const Hist *h, double q)
+{
+    uint64_t rank = q * h->total;
+    if (rank < 1) {
+        rank = 1;
+    }
+    uint64_t seen = 0;
+    for (unsigned i = 0; i < HIST_NBUCKETS; ++i) {
+        seen += h->counts[i];
+        if (seen >= rank) {
+            uint64_t v = hist_bucket_max(i);
+            return v < h->max ? v : h->max;
+        }
+    }
+    return h->max;
+}
+
+//-----------------------------------------------------------------------------
+
+typedef struct {
+    int fd;
+    bool want_out;
+    // the message in flight; 'size' is 0 if there is none
+    uint32_t size, sent, received;
+    uint64_t start;
+    // rate mode: messages that became due / that were sent
+    uint64_t due, issued;
+} Conn;
+
+enum { MAX_MSG_SIZE = 1024 * 1024 };
+enum { EPEVBUF_SIZE = 1024 };
+
+static Conn *conns;
+static size_t nconns;
+static uint32_t size_min = 64, size_max = 64;
+// with framing, a message is 'depth' frames of 'size_min' bytes each, sent back to back
+static char framing; // 0, 'l' for 'len' or 'n' for 'line'
+static unsigned long depth = 1;
+static double rate; // messages per second over all connections, 0 for closed loop
+static uint64_t interval_ns;
+static uint64_t t_begin;
+static int efd;
+static char payload[MAX_MSG_SIZE];
+static char scratch[MAX_MSG_SIZE];
+
+static Hist hist;
+static uint64_t nbytes;
+
+// When the 'm'-th message of connection 'i' is due in rate mode.
+#define due_time(I_, M_) (t_begin + ((M_) * nconns + (I_)) * interval_ns)
+
+static void conn_want_out(Conn *c, bool want)
+{
+    if (c->want_out == want) {
+        return;
+    }
+    if (epoll_ctl(efd, EPOLL_CTL_MOD, c->fd, &(struct epoll_event) {
+            .events = EPOLLIN | (want ? EPOLLOUT : 0),
+            .data.ptr = c,
+        }) < 0)
+    {
+        perror("epoll_ctl (EPOLL_CTL_MOD)");
+        exit(1);
+    }
+    c->want_out = want;
+}
+
+static void conn_flush(Conn *c)
+{
+    while (c->sent != c->size) {
+        ssize_t w = write(c->fd, payload + c->sent, c->size - c->sent);
+        if (w < 0) {
+            if (errno == EAGAIN) {
+                conn_want_out(c, true);
+                return;
+            }
+            perror("write");
+            exit(1);
+        }
+        c->sent += w;
+    }
+    conn_want_out(c, false);
+}
+
+static void conn_start(Conn *c)
+{
+    uint32_t span = size_max - size_min + 1;
+    c->size = size_min + (span > 1 ? rng_next() % span : 0);
+    c->sent = c->received = 0;
+    // in rate mode the latency counts from when the message was due, not from when it
+    // could be sent, so that a slow server cannot hide its stalls.
+    c->start = rate ? due_time(c - conns, c->issued) : now_ns();
+    ++c->issued;
+    conn_flush(c);
+}
+
+static void conn_read(Conn *c, bool measuring)
+{
+    while (1) {
+        size_t want = c->size - c->received;
+        if (!want) {
+            // stray data; the server does not send anything on its own.
+            want = sizeof(scratch);
+        }
+        ssize_t r = read(c->fd, scratch, want);
+        if (r < 0) {
+            if (errno == EAGAIN) {
+                return;
+            }
+            perror("read");
+            exit(1);
+        }
+        if (r == 0) {
+            fprintf(stderr, "Connection closed by the server.\n");
+            exit(1);
+        }
+        if (!c->size) {
+            continue;
+        }
+        c->received += r;
+        if (c->received == c->size) {
+            if (measuring) {
+                hist_record(&hist, now_ns() - c->start);
+                nbytes += c->size;
+            }
+            c->size = 0;
+            if (!rate || c->issued < c->due) {
+                conn_start(c);
+            }
+        }
+    }
+}
+
+static int conn_open(const struct sockaddr_in *sa)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+    if (connect(fd, (const struct sockaddr *) sa, sizeof(*sa)) < 0) {
+        perror("connect");
+        close(fd);
+        return -1;
+    }
+    if (setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &(int) {1}, sizeof(int)) < 0) {
+        perror("setsockopt (TCP_NODELAY)");
+        // note: no return
+    }
+    int flags = fcntl(fd, F_GETFL);
+    if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+        perror("fcntl");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+//-----------------------------------------------------------------------------
+// check
+//
+// Connection isolation with framing: one connection sends a good frame and then a bad one,
+// which makes the server close it, and then the next connection has to get back its own frame
+// and nothing else. Both should land on the same server thread, so run the server with one.
+
+// Writes out a frame of 'data' for the current framing into 'buf'; returns its size.
+static size_t check_frame(char *buf, const char *data, size_t len)
+{
+    if (framing == 'l') {
+        buf[0] = len >> 24;
+        buf[1] = len >> 16;
+        buf[2] = len >> 8;
+        buf[3] = len;
+        memcpy(buf + 4, data, len);
+        return len + 4;
+    }
+    memcpy(buf, data, len);
+    buf[len] = '\n';
+    return len + 1;
+}
+
+// A blocking connection whose reads time out after 'timeout_ms'.
+static int check_open(const struct sockaddr_in *sa, int timeout_ms)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+    struct timeval tv = {.tv_sec = timeout_ms / 1000, .tv_usec = timeout_ms % 1000 * 1000};
+    if (setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) < 0
+        || connect(fd, (const struct sockaddr *) sa, sizeof(*sa)) < 0)
+    {
+        perror("connect");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static bool check_write(int fd, const char *buf, size_t n)
+{
+    while (n) {
+        ssize_t w = write(fd, buf, n);
+        if (w < 0) {
+            return false;
+        }
+        buf += w;
+        n -= w;
+    }
+    return true;
+}
+
+static void check_dump(const char *what, const char *buf, size_t n)
+{
+    fprintf(stderr, "%s (%zu bytes): ", what, n);
+    for (size_t i = 0; i < n; ++i) {
+        unsigned char c = buf[i];
+        fprintf(stderr, c >= 0x20 && c < 0x7f && c != '\\' ? "%c" : "\\x%02x", c);
+    }
+    fprintf(stderr, "\n");
+}
+
+static int check_isolation(const struct sockaddr_in *sa)
+{
+    static const char a_data[] = "hello-a", b_data[] = "hello-b";
+
+    // a good frame and a bad one in the same write: a length over the limit, or a line
+    // longer than any the server takes
+    int a = check_open(sa, 2000);
+    if (a < 0) {
+        return 1;
+    }
+    size_t n = check_frame(payload, a_data, sizeof(a_data) - 1);
+    if (framing == 'l') {
+        memset(payload + n, 0xff, 4);
+        n += 4;
+    } else {
+        memset(payload + n, 'x', 64 * 1024);
+        n += 64 * 1024;
+    }
+    check_write(a, payload, n); // the server may close before it takes all of it
+    while (1) {
+        ssize_t r = read(a, scratch, sizeof(scratch));
+        if (r == 0 || (r < 0 && errno == ECONNRESET)) {
+            break;
+        }
+        if (r < 0) {
+            fprintf(stderr, "check: the server did not close the connection that sent a "
+                            "bad frame.\n");
+            close(a);
+            return 1;
+        }
+    }
+    close(a);
+
+    int b = check_open(sa, 200);
+    if (b < 0) {
+        return 1;
+    }
+    char want[16];
+    size_t want_len = check_frame(want, b_data, sizeof(b_data) - 1);
+    if (!check_write(b, want, want_len)) {
+        perror("write");
+        close(b);
+        return 1;
+    }
+    // everything that comes back until the server goes quiet
+    size_t got = 0;
+    for (ssize_t r; got < sizeof(scratch); got += r) {
+        if ((r = read(b, scratch + got, sizeof(scratch) - got)) <= 0) {
+            break;
+        }
+    }
+    close(b);
+    if (got != want_len || memcmp(scratch, want, want_len)) {
+        fprintf(stderr, "check: FAILED\n");
+        check_dump("  sent    ", want, want_len);
+        check_dump("  received", scratch, got);
+        return 1;
+    }
+    printf("check: ok\n");
+    return 0;
+}
+
+//-----------------------------------------------------------------------------
+
+static void usage(void)
+{
+    fprintf(stderr, "USAGE: epoll_et_load [-c CONNS] [-s SIZE | -s MIN-MAX] [-r RATE]\n"
+                    "                     [-d SECONDS] [-w SECONDS] [-f FRAMING [-p DEPTH]]\n"
+                    "                     [-h ADDR] PORT\n"
+                    "       epoll_et_load -k -f FRAMING [-h ADDR] PORT\n"
+                    "  -c CONNS    open CONNS connections (default: 16)\n"
+                    "  -s SIZE     message size in bytes, or a range to pick uniformly from\n"
+                    "              (default: 64)\n"
+                    "  -r RATE     send RATE messages per second over all connections; by default\n"
+                    "              every connection sends its next message once the previous\n"
+                    "              one is echoed back\n"
+                    "  -d SECONDS  measure for SECONDS (default: 10)\n"
+                    "  -w SECONDS  run for SECONDS before measuring (default: 1)\n"
+                    "  -f FRAMING  send frames for 'epoll_et_srv -f FRAMING' (len or line) with\n"
+                    "              SIZE-byte payloads instead of raw bytes\n"
+                    "  -p DEPTH    with -f, pipeline DEPTH frames per message (default: 1)\n"
+                    "  -h ADDR     server IPv4 address (default: 127.0.0.1)\n"
+                    "  -k          instead of a load, check that a connection that sends a bad\n"
+                    "              frame leaves nothing behind for the next one (run the server\n"
+                    "              with a single thread)\n");
+    exit(2);
+}
+
+static bool parse_ulong(const char *s, unsigned long *out)
+{
+    errno = 0;
+    char *endptr;
+    *out = strtoul(s, &endptr, 10);
+    return !errno && endptr != s && *endptr == '\0';
+}
+
+static bool parse_size(const char *s)
+{
+    unsigned long lo, hi;
+    const char *dash = strchr(s, '-');
+    if (dash) {
+        char buf[32];
+        size_t n = dash - s;
+        if (n >= sizeof(buf)) {
+            return false;
+        }
+        memcpy(buf, s, n);
+        buf[n] = '\0';
+        if (!parse_ulong(buf, &lo) || !parse_ulong(dash + 1, &hi)) {
+            return false;
+        }
+    } else {
+        if (!parse_ulong(s, &lo)) {
+            return false;
+        }
+        hi = lo;
+    }
+    if (lo == 0 || lo > hi || hi > MAX_MSG_SIZE) {
+        return false;
+    }
+    size_min = lo;
+    size_max = hi;
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned long nconns_arg = 16, duration = 10, warmup = 1;
+    const char *addr = "127.0.0.1";
+    bool check = false;
+    for (int c; (c = getopt(argc, argv, "c:s:r:d:w:f:p:h:k")) != -1;) {
+        switch (c) {
+        case 'c':
+            if (!parse_ulong(optarg, &nconns_arg) || nconns_arg == 0) {
+                fprintf(stderr, "CONNS is not a valid number of connections.\n");
+                usage();
+            }
+            break;
+        case 's':
+            if (!parse_size(optarg)) {
+                fprintf(stderr, "SIZE must be from 1 to %d.\n", (int) MAX_MSG_SIZE);
+                usage();
+            }
+            break;
+        case 'r': {
+            unsigned long r;
+            if (!parse_ulong(optarg, &r) || r == 0) {
+                fprintf(stderr, "RATE is not a valid rate.\n");
+                usage();
+            }
+            rate = r;
+            break;
+        }
+        case 'd':
+            if (!parse_ulong(optarg, &duration) || duration == 0) {
+                fprintf(stderr, "SECONDS is not a valid duration.\n");
+                usage();
+            }
+            break;
+        case 'w':
+            if (!parse_ulong(optarg, &warmup)) {
+                fprintf(stderr, "SECONDS is not a valid duration.\n");
+                usage();
+            }
+            break;
+        case 'f':
+            if (strcmp(optarg, "len") == 0) {
+                framing = 'l';
+            } else if (strcmp(optarg, "line") == 0) {
+                framing = 'n';
+            } else {
+                fprintf(stderr, "FRAMING must be 'len' or 'line'.\n");
+                usage();
+            }
+            break;
+        case 'p':
+            if (!parse_ulong(optarg, &depth) || depth == 0) {
+                fprintf(stderr, "DEPTH is not a valid pipeline depth.\n");
+                usage();
+            }
+            break;
+        case 'h':
+            addr = optarg;
+            break;
+        case 'k':
+            check = true;
+            break;
+        default:
+            usage();
+        }
+    }
+    if (argc - optind != 1) {
+        usage();
+    }
+    unsigned long port;
+    if (!parse_ulong(argv[optind], &port) || port == 0 || port > 65535) {
+        fprintf(stderr, "PORT is not a valid port number.\n");
+        usage();
+    }
+    struct sockaddr_in sa = {
+        .sin_family = AF_INET,
+        .sin_port = htons(port),
+    };
+    if (inet_pton(AF_INET, addr, &sa.sin_addr) != 1) {
+        fprintf(stderr, "ADDR is not a valid IPv4 address.\n");
+        usage();
+    }
+    if (signal(SIGPIPE, SIG_IGN) == SIG_ERR) {
+        perror("signal");
+        return 1;
+    }
+    if (check) {
+        if (!framing) {
+            fprintf(stderr, "-k needs -f.\n");
+            usage();
+        }
+        return check_isolation(&sa);
+    }
+    memset(payload, 'x', sizeof(payload));
+    if (framing) {
+        if (size_min != size_max) {
+            fprintf(stderr, "-f needs a fixed SIZE.\n");
+            usage();
+        }
+        size_t frame_size = size_min + (framing == 'l' ? 4 : 1);
+        if (depth > MAX_MSG_SIZE / frame_size) {
+            fprintf(stderr, "DEPTH frames of SIZE bytes do not fit in %d bytes.\n",
+                    (int) MAX_MSG_SIZE);
+            usage();
+        }
+        for (unsigned long i = 0; i < depth; ++i) {
+            char *f = payload + i * frame_size;
+            if (framing == 'l') {
+                f[0] = size_min >> 24;
+                f[1] = size_min >> 16;
+                f[2] = size_min >> 8;
+                f[3] = size_min;
+            } else {
+                f[size_min] = '\n';
+            }
+        }
+        size_min = size_max = depth * frame_size;
+    }
+
+    efd = epoll_create1(0);
+    if (efd < 0) {
+        perror("epoll_create1");
+        return 1;
+    }
+    nconns = nconns_arg;
+    conns = xmalloc(nconns, sizeof(Conn));
+    for (size_t i = 0; i < nconns; ++i) {
+        int fd = conn_open(&sa);
+        if (fd < 0) {
+            return 1;
+        }
+        conns[i] = (Conn) {.fd = fd};
+        if (epoll_ctl(efd, EPOLL_CTL_ADD, fd, &(struct epoll_event) {
+                .events = EPOLLIN,
+                .data.ptr = &conns[i],
+            }) < 0)
+        {
+            perror("epoll_ctl (EPOLL_CTL_ADD)");
+            return 1;
+        }
+    }
+
+    t_begin = now_ns();
+    const uint64_t t_measure = t_begin + warmup * 1000000000;
+    const uint64_t t_end = t_measure + duration * 1000000000;
+    uint64_t nfired = 0;
+    if (rate) {
+        interval_ns = 1e9 / rate;
+        if (!interval_ns) {
+            interval_ns = 1;
+        }
+    } else {
+        for (size_t i = 0; i < nconns; ++i) {
+            conn_start(&conns[i]);
+        }
+    }
+
+    struct epoll_event *epevbuf = xmalloc(EPEVBUF_SIZE, sizeof(struct epoll_event));
+    bool measuring = false;
+    while (1) {
+        uint64_t t = now_ns();
+        if (t >= t_end) {
+            break;
+        }
+        if (!measuring && t >= t_measure) {
+            measuring = true;
+        }
+        uint64_t wait_ns = t_end - t;
+        if (rate) {
+            // connections fire in turn, one every 'interval_ns'.
+            for (uint64_t due; (due = t_begin + nfired * interval_ns) <= t; ++nfired) {
+                Conn *c = &conns[nfired % nconns];
+                ++c->due;
+                if (!c->size) {
+                    conn_start(c);
+                }
+            }
+            uint64_t until_due = t_begin + nfired * interval_ns - t;
+            if (until_due < wait_ns) {
+                wait_ns = until_due;
+            }
+        }
+        // epoll_pwait2() rather than epoll_wait(): at high rates the next message is due in
+        // less than the millisecond epoll_wait() can sleep for.
+        int nfds = epoll_pwait2(efd, epevbuf, EPEVBUF_SIZE, &(struct timespec) {
+                .tv_sec = wait_ns / 1000000000,
+                .tv_nsec = wait_ns % 1000000000,
+            }, NULL);
+        if (nfds < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("epoll_wait");
+            return 1;
+        }
+        for (int i = 0; i < nfds; ++i) {
+            Conn *c = epevbuf[i].data.ptr;
+            if (epevbuf[i].events & EPOLLOUT) {
+                conn_flush(c);
+            }
+            if (epevbuf[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)) {
+                conn_read(c, measuring);
+            }
+        }
+    }
+
+    double secs = duration;
+    printf("connections: %zu, message size: %u-%u, %s\n",
+           nconns, size_min, size_max, rate ? "fixed rate" : "closed loop");
+    if (framing) {
+        printf("frames:      %lu per message, %.0f/s\n", depth, hist.total * depth / secs);
+    }
+    printf("messages:    %llu (%.0f/s), %.1f MB/s each way\n",
+           (unsigned long long) hist.total, hist.total / secs, nbytes / secs / 1e6);
+    if (!hist.total) {
+        return 1;
+    }
+    printf("latency:     p50 %.1f us, p99 %.1f us, p999 %.1f us, max %.1f us\n",
+           hist_quantile(&hist, 0.5) / 1e3,
+           hist_quantile(&hist, 0.99) / 1e3,
+           hist_quantile(&hist, 0.999) / 1e3,
+           hist.max / 1e3);
+    return 0;
+}
@@ -1,15 +1,30 @@
 // TCP echo server using edge-triggered epoll.
 // Written for https://www.linux.org.ru/forum/development/13538162/.
+//
+// Compile with:
+//   gcc -O2 -pthread epoll_et_srv.c -o epoll_et_srv
+#define _GNU_SOURCE
 #include <sys/epoll.h>
 #include <stdio.h>
 #include <stdbool.h>
 #include <stdlib.h>
+#include <string.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <signal.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <limits.h>
+#include <stdint.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
 #include <arpa/inet.h>
+#include <linux/io_uring.h>
 
 static void * xmalloc(size_t nelems, size_t elemsz)
 {
@@ -32,224 +47,1864 @@ static int make_nonblock(int fd)
 }
 
 //-----------------------------------------------------------------------------
+// metrics (one set per thread)
+//
+// A thread only updates its own counters, with plain stores. With -m they live in a shared
+// memory object that 'epoll_et_srv stats' reads while the server runs; aligned 64-bit stores
+// are not torn, so the reader sees each counter either before or after an update.
+
+enum { METRICS_NBATCHES = 12 };
+
+typedef struct {
+    uint64_t accepts;
+    uint64_t closes;
+    uint64_t timeouts;
+    uint64_t live_slots;
+    uint64_t chunks;
+    uint64_t bytes_in, bytes_out;
+    uint64_t eagain_in, eagain_out;
+    uint64_t partial_writes;
+    // events per wakeup: 0, 1, 2-3, 4-7, ..., 1024 and more
+    uint64_t batches[METRICS_NBATCHES];
+} __attribute__((aligned(64))) Metrics;
+
+#define METRICS_MAGIC UINT64_C(0x3173636972746d65)
 
-enum { BUFSZ = 4 * 1024 };
 typedef struct {
+    uint64_t magic;
+    uint64_t nthreads;
+    Metrics threads[];
+} MetricsShm;
+
+static __thread Metrics *mt;
+
+static inline void metrics_batch(size_t nevents)
+{
+    unsigned i = nevents ? 64 - __builtin_clzll(nevents) : 0;
+    ++mt->batches[i < METRICS_NBATCHES ? i : METRICS_NBATCHES - 1];
+}
+
+//-----------------------------------------------------------------------------
+
+enum { BUFSZ = 4 * 1024 };
+typedef struct Datum {
     union {
-        char buf[BUFSZ];
+        // Data that is read but not yet written, in a buffer borrowed from the buffer pool
+        // (the frame pool with framing); NULL if there is none.
+        char *buf;
         void *ptr;
     } u;
-    size_t buf_start, buf_end;
+    unsigned buf_start, buf_end;
     int fd;
+    // framing: input that is not parsed yet, in a buffer borrowed from the frame pool; NULL
+    // if there is none. 'in_ready' is set if it may hold complete frames.
+    char *in;
+    unsigned in_len;
+    bool in_ready;
+    // splice mode: data goes socket -> pipe -> socket without passing through a buffer.
+    // 'pipe_rd' is -1 if the datum echoes through the buffer instead.
+    int pipe_rd, pipe_wr;
+    unsigned pipe_len;
+    // timeouts: when the datum last read something, and since when its output is stuck
+    // (valid if 'stalling'); in ticks, modulo 2^32.
+    uint32_t active, stalled;
+    bool stalling;
+    // link in the ready queue, valid if 'queued'
+    bool queued;
+    // tick (modulo 2^32) of the timer wheel slot the datum is in, valid if 'tw_pprev'
+    uint32_t tw_expire;
+    struct Datum *next_ready;
+    struct Datum *tw_next, **tw_pprev;
 } Datum;
 
 #define datum_ptr(Dtm_) (Dtm_)->u.ptr
 
 //-----------------------------------------------------------------------------
-// slot allocator
+// buffer pools (one of each per thread)
+//
+// A connection only holds a buffer while a write is pending; everything else is read into
+// 'bp_scratch' and written back from there. With framing, the buffers come from 'fp', the
+// pool of FRAME_BUFSZ buffers, and also hold partial input frames.
 
-static Datum *sal_trash_top;
-static size_t sal_next_alloc = 1024; // must be >= 2
+enum { FRAME_BUFSZ = 64 * 1024 };
 
-static Datum * sal_alloc(void)
+typedef struct {
+    void *trash_top;
+    size_t bufsz;
+    size_t next_alloc;
+} BufPool;
+
+static __thread char bp_scratch[BUFSZ];
+static __thread BufPool bp = {.bufsz = BUFSZ, .next_alloc = 64};
+static __thread BufPool fp = {.bufsz = FRAME_BUFSZ, .next_alloc = 4};
+
+static char * pool_alloc(BufPool *pool)
+{
+    if (!pool->trash_top) {
+        size_t n = pool->next_alloc, sz = pool->bufsz;
+        char *r = xmalloc(n, sz);
+        for (size_t i = 0; i < n; ++i) {
+            *(void **) (r + i * sz) = i + 1 == n ? NULL : r + (i + 1) * sz;
+        }
+        pool->trash_top = r;
+        pool->next_alloc *= 2;
+    }
+    char *r = pool->trash_top;
+    pool->trash_top = *(void **) r;
+    return r;
+}
+
+static void pool_free(BufPool *pool, char *p)
+{
+    *(void **) p = pool->trash_top;
+    pool->trash_top = p;
+}
+
+//-----------------------------------------------------------------------------
+// timer wheel (one per thread)
+//
+// TW_LEVELS levels of 64 slots, a level-L slot spanning 64^L ticks of 1 ms. A datum sits in
+// at most one slot and is not moved when it is active: only 'active' is updated. When its
+// slot comes due the datum is closed if its deadline has passed and put back according to
+// the deadline otherwise. Slots are found through the occupancy bitmaps, so the loop only
+// wakes up when some slot is actually due.
+
+enum { TW_BITS = 6, TW_SLOTS = 1 << TW_BITS, TW_LEVELS = 4 };
+
+#define TW_SPAN(Level_) (UINT64_C(1) << (TW_BITS * (Level_)))
+
+typedef struct {
+    Datum *slots[TW_LEVELS][TW_SLOTS];
+    uint64_t occupied[TW_LEVELS];
+    uint64_t now; // every slot that is due at or before this tick is processed
+} TimerWheel;
+
+static __thread TimerWheel tw;
+// the current tick, read once per wakeup; 'tw.now' may lag behind it
+static __thread uint64_t tw_tick;
+
+// in ticks; 0 if disabled
+static uint32_t idle_timeout, stall_timeout;
+
+#define timeouts_enabled() (idle_timeout || stall_timeout)
+
+static uint64_t tw_clock(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+    return (uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// Converts a tick modulo 2^32 that is within 2^31 ticks of 'tw.now' to the full tick.
+static inline uint64_t tw_unwrap(uint32_t tick)
+{
+    return tw.now + (int32_t) (tick - (uint32_t) tw.now);
+}
+
+// Returns the tick at which 'd' must be closed, or UINT64_MAX if never.
+static uint64_t datum_deadline(const Datum *d)
+{
+    uint64_t r = UINT64_MAX;
+    if (idle_timeout) {
+        r = tw_unwrap(d->active + idle_timeout);
+    }
+    if (stall_timeout && d->stalling) {
+        uint64_t s = tw_unwrap(d->stalled + stall_timeout);
+        if (s < r) {
+            r = s;
+        }
+    }
+    return r;
+}
+
+static void tw_insert(Datum *d, uint64_t expire)
+{
+    if (expire <= tw.now) {
+        expire = tw.now + 1;
+    }
+    if (expire - tw.now >= TW_SPAN(TW_LEVELS)) {
+        // too far; the datum is put back when this comes due.
+        expire = tw.now + TW_SPAN(TW_LEVELS) - 1;
+    }
+    unsigned level = 0;
+    while (expire - tw.now >= TW_SPAN(level + 1)) {
+        ++level;
+    }
+    unsigned slot = (expire >> (TW_BITS * level)) & (TW_SLOTS - 1);
+    Datum **head = &tw.slots[level][slot];
+    d->tw_next = *head;
+    if (*head) {
+        (*head)->tw_pprev = &d->tw_next;
+    }
+    d->tw_pprev = head;
+    *head = d;
+    d->tw_expire = expire;
+    tw.occupied[level] |= UINT64_C(1) << slot;
+}
+
+static void tw_remove(Datum *d)
+{
+    if (!d->tw_pprev) {
+        return;
+    }
+    *d->tw_pprev = d->tw_next;
+    if (d->tw_next) {
+        d->tw_next->tw_pprev = d->tw_pprev;
+    }
+    d->tw_pprev = NULL;
+    // the occupancy bit is left set; the slot is found empty when it comes due.
+}
+
+// Makes sure 'd' is in a slot that comes due no later than its deadline.
+static void tw_arm(Datum *d)
+{
+    uint64_t deadline = datum_deadline(d);
+    if (deadline == UINT64_MAX) {
+        return;
+    }
+    if (!d->tw_pprev || deadline < tw_unwrap(d->tw_expire)) {
+        tw_remove(d);
+        tw_insert(d, deadline);
+    }
+}
+
+// Returns the next tick at which some slot comes due, or UINT64_MAX if the wheel is empty.
+static uint64_t tw_next_tick(void)
+{
+    uint64_t r = UINT64_MAX;
+    for (unsigned level = 0; level < TW_LEVELS; ++level) {
+        uint64_t occupied = tw.occupied[level];
+        if (!occupied) {
+            continue;
+        }
+        unsigned shift = TW_BITS * level;
+        uint64_t pos = tw.now >> shift;
+        unsigned cur = pos & (TW_SLOTS - 1);
+        uint64_t round = pos - cur;
+        uint64_t later = cur == TW_SLOTS - 1 ? 0 : occupied & (~UINT64_C(0) << (cur + 1));
+        uint64_t t = later ? round + __builtin_ctzll(later)
+                           : round + TW_SLOTS + __builtin_ctzll(occupied);
+        t <<= shift;
+        if (t < r) {
+            r = t;
+        }
+    }
+    return r;
+}
+
+// Processes the slots that come due up to tick 'target'. Returns the datums whose deadline
+// has passed, linked through 'tw_next'.
+static Datum * tw_advance(uint64_t target)
+{
+    Datum *expired = NULL;
+    for (uint64_t t; (t = tw_next_tick()) <= target;) {
+        tw.now = t;
+        for (unsigned level = 0; level < TW_LEVELS; ++level) {
+            unsigned shift = TW_BITS * level;
+            if (t & (TW_SPAN(level) - 1)) {
+                break;
+            }
+            unsigned slot = (t >> shift) & (TW_SLOTS - 1);
+            Datum *d = tw.slots[level][slot];
+            tw.slots[level][slot] = NULL;
+            tw.occupied[level] &= ~(UINT64_C(1) << slot);
+            while (d) {
+                Datum *next = d->tw_next;
+                d->tw_pprev = NULL;
+                uint64_t deadline = datum_deadline(d);
+                if (deadline <= t) {
+                    d->tw_next = expired;
+                    expired = d;
+                } else if (deadline != UINT64_MAX) {
+                    tw_insert(d, deadline);
+                }
+                d = next;
+            }
+        }
+    }
+    if (target > tw.now) {
+        tw.now = target;
+    }
+    return expired;
+}
+
+//-----------------------------------------------------------------------------
+// slot allocator (one per thread)
+//
+// Datums are carved out of chunks aligned to their size, so the chunk of a datum is found by
+// masking its address. A chunk hands out its never-used slots in order before reusing freed
+// ones, so its pages are only touched as they are needed. A chunk that becomes empty is
+// kept for SAL_GRACE_MS, in case the connections come back, and unmapped after that.
+
+typedef struct SalChunk {
+    Datum *free_top;
+    unsigned nused;
+    unsigned nbumped; // slots [0, nbumped) have been handed out at least once
+    uint64_t emptied; // tick at which the chunk became empty, valid if on 'sal_empty'
+    struct SalChunk *prev, *next;
+} SalChunk;
+
+typedef struct {
+    SalChunk *head, *tail;
+} SalList;
+
+enum { SAL_GRACE_MS = 10 * 1000 };
+
+static size_t sal_chunk_size = 64 * 1024;
+static bool sal_hugepages;
+
+// chunks with used and free slots; empty chunks, in the order they became empty
+static __thread SalList sal_partial, sal_empty;
+
+#define sal_chunk_of(Dtm_) ((SalChunk *) ((uintptr_t) (Dtm_) & ~(uintptr_t) (sal_chunk_size - 1)))
+#define sal_slots(Chunk_) ((Datum *) ((char *) (Chunk_) + sal_header_size()))
+
+static inline size_t sal_header_size(void)
+{
+    return (sizeof(SalChunk) + _Alignof(Datum) - 1) / _Alignof(Datum) * _Alignof(Datum);
+}
+
+static inline unsigned sal_nslots(void)
+{
+    return (sal_chunk_size - sal_header_size()) / sizeof(Datum);
+}
+
+static void sal_list_push(SalList *l, SalChunk *c, bool front)
 {
-    if (sal_trash_top) {
-        Datum *r = sal_trash_top;
-        sal_trash_top = datum_ptr(sal_trash_top);
-        return r;
+    if (front) {
+        c->prev = NULL;
+        c->next = l->head;
+        *(l->head ? &l->head->prev : &l->tail) = c;
+        l->head = c;
     } else {
-        Datum *r = xmalloc(sal_next_alloc, sizeof(Datum));
-        for (size_t i = 1; i < sal_next_alloc - 1; ++i) {
-            datum_ptr(r + i) = &r[i + 1];
+        c->next = NULL;
+        c->prev = l->tail;
+        *(l->tail ? &l->tail->next : &l->head) = c;
+        l->tail = c;
+    }
+}
+
+static void sal_list_remove(SalList *l, SalChunk *c)
+{
+    *(c->prev ? &c->prev->next : &l->head) = c->next;
+    *(c->next ? &c->next->prev : &l->tail) = c->prev;
+}
+
+static SalChunk * sal_chunk_new(void)
+{
+    size_t size = sal_chunk_size;
+    // map twice the size and trim it to an aligned chunk
+    char *p = mmap(NULL, 2 * size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) {
+        perror("mmap");
+        abort();
+    }
+    char *c = (char *) (((uintptr_t) p + size - 1) & ~(uintptr_t) (size - 1));
+    if (c != p) {
+        munmap(p, c - p);
+    }
+    munmap(c + size, p + size - c);
+    if (sal_hugepages && madvise(c, size, MADV_HUGEPAGE) < 0) {
+        perror("madvise (MADV_HUGEPAGE)");
+        // note: no return
+    }
+    ++mt->chunks;
+    SalChunk *chunk = (SalChunk *) c;
+    chunk->free_top = NULL;
+    chunk->nused = chunk->nbumped = 0;
+    return chunk;
+}
+
+static Datum * sal_alloc(void)
+{
+    SalChunk *c = sal_partial.head;
+    if (!c) {
+        // the most recently emptied chunk is the likeliest to be still resident
+        c = sal_empty.tail;
+        if (c) {
+            sal_list_remove(&sal_empty, c);
+        } else {
+            c = sal_chunk_new();
         }
-        datum_ptr(r + sal_next_alloc - 1) = NULL;
-        sal_trash_top = r + 1;
-        sal_next_alloc *= 2;
-        return r;
+        sal_list_push(&sal_partial, c, true);
+    }
+    Datum *r;
+    if (c->free_top) {
+        r = c->free_top;
+        c->free_top = datum_ptr(r);
+    } else {
+        r = sal_slots(c) + c->nbumped++;
+    }
+    if (++c->nused == sal_nslots()) {
+        sal_list_remove(&sal_partial, c);
     }
+    ++mt->live_slots;
+    return r;
 }
 
 static void sal_free(Datum *p)
 {
-    datum_ptr(p) = sal_trash_top;
-    sal_trash_top = p;
+    SalChunk *c = sal_chunk_of(p);
+    if (c->nused-- == sal_nslots()) {
+        sal_list_push(&sal_partial, c, true);
+    }
+    datum_ptr(p) = c->free_top;
+    c->free_top = p;
+    if (!c->nused) {
+        sal_list_remove(&sal_partial, c);
+        c->emptied = tw_clock();
+        sal_list_push(&sal_empty, c, false);
+    }
+    --mt->live_slots;
+}
+
+// Returns the tick at which the next empty chunk is due to be released, or UINT64_MAX.
+static inline uint64_t sal_next_release(void)
+{
+    return sal_empty.head ? sal_empty.head->emptied + SAL_GRACE_MS : UINT64_MAX;
+}
+
+// Unmaps the chunks that have been empty for SAL_GRACE_MS as of tick 'now'.
+static void sal_release(uint64_t now)
+{
+    while (sal_empty.head && sal_empty.head->emptied + SAL_GRACE_MS <= now) {
+        SalChunk *c = sal_empty.head;
+        sal_list_remove(&sal_empty, c);
+        if (munmap(c, sal_chunk_size) < 0) {
+            perror("munmap");
+            // note: no return
+        }
+        --mt->chunks;
+    }
 }
 
 //-----------------------------------------------------------------------------
 
+static bool use_splice;
+
+typedef enum {
+    FRAMING_NONE, // raw echo
+    FRAMING_LEN,  // 4-byte big-endian length, then that many bytes
+    FRAMING_LINE, // bytes up to a '\n'
+} Framing;
+
+static Framing framing;
+
+enum { SPLICE_CHUNK = 64 * 1024 };
+
 static Datum * datum_create(int fd)
 {
     Datum *d = sal_alloc();
+    d->u.buf = NULL;
+    d->in = NULL;
+    d->in_len = 0;
+    d->in_ready = false;
     d->buf_start = d->buf_end = 0;
     d->fd = fd;
+    d->pipe_rd = d->pipe_wr = -1;
+    d->pipe_len = 0;
+    d->queued = false;
+    d->active = tw_tick;
+    d->stalling = false;
+    d->tw_pprev = NULL;
+    if (idle_timeout) {
+        tw_insert(d, tw_tick + idle_timeout);
+    }
+    if (use_splice) {
+        int pipefd[2];
+        if (pipe2(pipefd, O_NONBLOCK) < 0) {
+            perror("pipe2");
+            // note: falls back to the buffer
+        } else {
+            d->pipe_rd = pipefd[0];
+            d->pipe_wr = pipefd[1];
+        }
+    }
     return d;
 }
 
-#define datum_destroy sal_free
+static void datum_close_pipe(Datum *d)
+{
+    if (d->pipe_rd >= 0) {
+        close(d->pipe_rd);
+        close(d->pipe_wr);
+        d->pipe_rd = d->pipe_wr = -1;
+    }
+}
+
+static void datum_destroy(Datum *d)
+{
+    tw_remove(d);
+    if (d->u.buf) {
+        pool_free(framing ? &fp : &bp, d->u.buf);
+    }
+    if (d->in) {
+        pool_free(&fp, d->in);
+    }
+    datum_close_pipe(d);
+    sal_free(d);
+}
 
 #define datum_fd(Dtm_) (Dtm_)->fd
 
-static inline bool datum_echo(Datum *d)
+// How many bytes one datum_echo() call may move before it yields to other connections.
+enum { ECHO_BUDGET = 64 * 1024 };
+
+typedef enum {
+    ECHO_CLOSE, // EOF or error: the connection must be closed
+    ECHO_WAIT,  // got EAGAIN: the next edge will bring the datum back
+    ECHO_YIELD, // used up the budget: must be called again without waiting for an event
+} EchoResult;
+
+#define echo_errno_result() (errno == EAGAIN ? ECHO_WAIT : ECHO_CLOSE)
+
+static inline EchoResult datum_echo_buf(Datum *d)
 {
     int fd = d->fd;
-    char *buf = d->u.buf;
 
-    size_t buf_start = d->buf_start;
-    size_t buf_end   = d->buf_end;
-    while (buf_start != buf_end) {
-        ssize_t w = write(fd, buf + buf_start, buf_end - buf_start);
-        if (w < 0) {
-            return errno == EAGAIN;
+    if (d->u.buf) {
+        unsigned buf_start = d->buf_start;
+        unsigned buf_end   = d->buf_end;
+        while (buf_start != buf_end) {
+            ssize_t w = write(fd, d->u.buf + buf_start, buf_end - buf_start);
+            if (w < 0) {
+                mt->eagain_out += errno == EAGAIN;
+                return echo_errno_result();
+            }
+            mt->bytes_out += w;
+            mt->partial_writes += (size_t) w != buf_end - buf_start;
+            d->buf_start = (buf_start += w);
         }
-        d->buf_start = (buf_start += w);
+        pool_free(&bp, d->u.buf);
+        d->u.buf = NULL;
     }
 
-    while (1) {
+    char *buf = bp_scratch;
+    for (size_t moved = 0; moved < ECHO_BUDGET;) {
         ssize_t r = read(fd, buf, BUFSZ);
         switch (r) {
         case -1:
-            return errno == EAGAIN;
+            mt->eagain_in += errno == EAGAIN;
+            return echo_errno_result();
         case 0:
-            return false;
+            return ECHO_CLOSE;
         default:
+            mt->bytes_in += r;
+            d->active = tw_tick;
             for (size_t written = 0; written != (size_t) r;) {
                 ssize_t w = write(fd, buf + written, r - written);
                 if (w < 0) {
-                    d->buf_start = written;
-                    d->buf_end = r;
-                    return errno == EAGAIN;
+                    if (errno != EAGAIN) {
+                        return ECHO_CLOSE;
+                    }
+                    ++mt->eagain_out;
+                    d->u.buf = pool_alloc(&bp);
+                    memcpy(d->u.buf, buf + written, r - written);
+                    d->buf_start = 0;
+                    d->buf_end = r - written;
+                    return ECHO_WAIT;
                 }
+                mt->bytes_out += w;
+                mt->partial_writes += (size_t) w != r - written;
                 written += w;
             }
+            moved += r;
         }
     }
 
-    return true;
+    return ECHO_YIELD;
 }
 
-//-----------------------------------------------------------------------------
-
-enum { EPEVBUF_SIZE = 1024 };
-
-void srv_epoll_run(int sfd)
+static inline EchoResult datum_echo_splice(Datum *d)
 {
-    if (signal(SIGPIPE, SIG_IGN) == SIG_ERR) {
-        perror("signal");
-        return;
-    }
-    struct epoll_event *epevbuf = xmalloc(EPEVBUF_SIZE, sizeof(struct epoll_event));
-    int efd = epoll_create1(0);
-    if (efd < 0) {
-        perror("epoll_create1");
-        return;
-    }
-    if (make_nonblock(sfd) < 0) {
-        perror("make_nonblock (on server socket fd)");
-        return;
-    }
-    if (epoll_ctl(efd, EPOLL_CTL_ADD, sfd, &(struct epoll_event) {
-            .events = EPOLLIN | EPOLLET,
-            .data.ptr = NULL,
-        }) < 0)
-    {
-        perror("epoll_ctl (EPOLL_CTL_ADD on server socket fd)");
-        return;
-    }
-    while (1) {
-        int nfds = epoll_wait(efd, epevbuf, EPEVBUF_SIZE, -1);
-        if (nfds < 0) {
-            if (errno == EINTR) {
-                continue;
+    int fd = d->fd;
+    for (size_t moved = 0; moved < ECHO_BUDGET;) {
+        while (d->pipe_len) {
+            ssize_t w = splice(d->pipe_rd, NULL, fd, NULL, d->pipe_len,
+                               SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+            if (w < 0) {
+                mt->eagain_out += errno == EAGAIN;
+                return echo_errno_result();
             }
-            perror("epoll_wait");
-            return;
+            mt->bytes_out += w;
+            mt->partial_writes += (size_t) w != d->pipe_len;
+            d->pipe_len -= w;
         }
-        for (int i = 0; i < nfds; ++i) {
-            Datum *datum = epevbuf[i].data.ptr;
-            if (datum) {
-                if (!datum_echo(datum)) {
-                    int fd = datum_fd(datum);
-                    if (epoll_ctl(efd, EPOLL_CTL_DEL, fd, NULL) < 0) {
-                        perror("epoll_ctl (EPOLL_CTL_DEL on client fd)");
-                        return;
-                    }
-                    if (close(fd) < 0) {
-                        perror("close");
-                        // note: no return
-                    }
-                    datum_destroy(datum);
-                }
-            } else {
-                while (1) {
-                    int cfd = accept(sfd, NULL, NULL);
-                    if (cfd < 0) {
-                        break;
-                    }
-                    if (make_nonblock(cfd) < 0) {
-                        perror("make_nonblock (on client fd)");
-                        return;
-                    }
-                    if (epoll_ctl(efd, EPOLL_CTL_ADD, cfd, &(struct epoll_event) {
-                            .events = EPOLLIN | EPOLLOUT | EPOLLET,
-                            .data.ptr = datum_create(cfd),
-                        }) < 0)
-                    {
-                        perror("epoll_ctl (EPOLL_CTL_ADD on client fd)");
-                        return;
-                    }
-                }
-                if (errno != EAGAIN) {
-                    perror("accept");
-                    return;
-                }
+        // the pipe is empty now, so EAGAIN can only mean that the socket is.
+        ssize_t r = splice(fd, NULL, d->pipe_wr, NULL, SPLICE_CHUNK,
+                           SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        switch (r) {
+        case -1:
+            if (errno == EINVAL) {
+                // this socket cannot be spliced; echo through the buffer from now on.
+                datum_close_pipe(d);
+                return datum_echo_buf(d);
             }
+            mt->eagain_in += errno == EAGAIN;
+            return echo_errno_result();
+        case 0:
+            return ECHO_CLOSE;
+        default:
+            mt->bytes_in += r;
+            d->active = tw_tick;
+            d->pipe_len = r;
+            moved += r;
         }
     }
+    // whatever is left in the pipe goes out on the next call.
+    return ECHO_YIELD;
 }
 
 //-----------------------------------------------------------------------------
+// framing
+//
+// Input is split into frames in place, and each frame is passed to the handler, which
+// queues its reply in a FrameOut. Replies are written with one writev() per batch; they may
+// point into the input (for an echo nothing is copied at all) or into the FrameOut's arena.
+// Only what writev() could not take is copied, into the datum's output buffer, and then no
+// more frames are parsed until it drains.
 
-static void usage(void)
+enum {
+    FRAME_MAX = 16 * 1024 - 4, // largest payload
+    FRAME_IOV = 256,           // iovecs per writev()
+    FRAME_OUT_MAX = FRAME_BUFSZ,
+};
+
+typedef struct {
+    struct iovec iov[FRAME_IOV];
+    int niov;
+    size_t bytes;
+    unsigned char hdrs[FRAME_IOV / 2][4];
+    int nhdrs;
+    size_t arena_used;
+    char arena[FRAME_OUT_MAX];
+} FrameOut;
+
+typedef struct {
+    // Handles one request. 'req' points into the input and stays valid until the batch is
+    // written. Replies by calling frame_reply() or frame_reply_alloc() at most once.
+    // Returns false to close the connection.
+    bool (*on_frame)(Datum *d, const char *req, size_t len, FrameOut *out);
+} FrameHandler;
+
+static __thread char fr_scratch[FRAME_BUFSZ];
+static __thread FrameOut fr_out;
+
+static inline void frame_push(FrameOut *out, const void *base, size_t len)
 {
-    fprintf(stderr, "USAGE: srv_epoll PORT\n");
-    exit(2);
+    out->iov[out->niov++] = (struct iovec) {.iov_base = (void *) base, .iov_len = len};
+    out->bytes += len;
 }
 
-int main(int argc, char **argv)
+// Drops whatever is queued. The iovecs point into the input of one connection, so nothing can be
+// left behind for the next one, whichever way the batch ends.
+static inline void frame_out_reset(FrameOut *out)
 {
-    if (argc != 2) {
-        usage();
+    out->niov = out->nhdrs = 0;
+    out->bytes = out->arena_used = 0;
+}
+
+// Queues a reply of 'len' bytes at 'data', which must stay valid until the batch is written.
+static bool frame_reply(FrameOut *out, const char *data, size_t len)
+{
+    if (len > FRAME_MAX) {
+        return false;
     }
-    errno = 0;
-    char *endptr;
-    unsigned long port = strtoul(argv[1], &endptr, 10);
-    if (errno || endptr == argv[1] || *endptr != '\0') {
-        fprintf(stderr, "PORT is not an integer.\n");
-        usage();
+    if (framing == FRAMING_LEN) {
+        unsigned char *hdr = out->hdrs[out->nhdrs++];
+        hdr[0] = len >> 24;
+        hdr[1] = len >> 16;
+        hdr[2] = len >> 8;
+        hdr[3] = len;
+        frame_push(out, hdr, 4);
+        frame_push(out, data, len);
+    } else {
+        frame_push(out, data, len);
+        frame_push(out, "\n", 1);
     }
-    if (port == 0 || port > 65535) {
-        fprintf(stderr, "PORT is not a valid port number.\n");
-        usage();
+    return true;
+}
+
+// Queues a reply of 'len' bytes that the caller fills in through the returned pointer.
+static inline char * frame_reply_alloc(FrameOut *out, size_t len)
+{
+    char *r = out->arena + out->arena_used;
+    if (!frame_reply(out, r, len)) {
+        return NULL;
     }
+    out->arena_used += len;
+    return r;
+}
 
-    int sfd = socket(PF_INET, SOCK_STREAM, IPPROTO_TCP);
-    if (sfd < 0) {
-        perror("socket");
+// Whether 'out' has room for one more reply of any size.
+#define frame_out_room(Out_) \
+    ((Out_)->niov + 2 <= FRAME_IOV && (Out_)->bytes + FRAME_MAX + 4 <= FRAME_OUT_MAX)
+
+static bool echo_on_frame(Datum *d, const char *req, size_t len, FrameOut *out)
+{
+    (void) d;
+    return frame_reply(out, req, len);
+}
+
+static const FrameHandler echo_handler = {.on_frame = echo_on_frame};
+
+static const FrameHandler *frame_handler = &echo_handler;
+
+// Finds the frame at the start of 'buf'. Returns 1 and fills in the rest if it is complete, 0
+// if more input is needed, and -1 if the input is not valid.
+static inline int frame_next(const char *buf, size_t n, const char **req, size_t *req_len,
+                             size_t *frame_len)
+{
+    if (framing == FRAMING_LEN) {
+        if (n < 4) {
+            return 0;
+        }
+        const unsigned char *u = (const unsigned char *) buf;
+        size_t len = (size_t) u[0] << 24 | (size_t) u[1] << 16 | (size_t) u[2] << 8 | u[3];
+        if (len > FRAME_MAX) {
+            return -1;
+        }
+        if (n < 4 + len) {
+            return 0;
+        }
+        *req = buf + 4;
+        *req_len = len;
+        *frame_len = 4 + len;
         return 1;
-    }
-    struct sockaddr_in sa = {
-        .sin_family = PF_INET,
-        .sin_port = htons(port),
-        .sin_addr.s_addr = htonl(INADDR_ANY),
-    };
-    if (bind(sfd, (struct sockaddr *) &sa, sizeof(sa)) < 0) {
-        perror("bind");
+    } else {
+        const char *nl = memchr(buf, '\n', n < FRAME_MAX + 1 ? n : FRAME_MAX + 1);
+        if (!nl) {
+            return n > FRAME_MAX ? -1 : 0;
+        }
+        *req = buf;
+        *req_len = nl - buf;
+        *frame_len = *req_len + 1;
         return 1;
     }
-    if (listen(sfd, SOMAXCONN) < 0) {
-        perror("listen");
-        return 1;
+}
+
+// Writes out the batch. Returns 1 if all of it is written, 0 if the rest is moved to the
+// datum's output buffer, and -1 on error.
+static int frame_flush(Datum *d, FrameOut *out)
+{
+    struct iovec *iov = out->iov;
+    int niov = out->niov;
+    while (niov) {
+        ssize_t w = writev(d->fd, iov, niov < IOV_MAX ? niov : IOV_MAX);
+        if (w < 0) {
+            if (errno != EAGAIN) {
+                frame_out_reset(out);
+                return -1;
+            }
+            ++mt->eagain_out;
+            char *buf = pool_alloc(&fp);
+            size_t n = 0;
+            for (int i = 0; i < niov; ++i) {
+                memcpy(buf + n, iov[i].iov_base, iov[i].iov_len);
+                n += iov[i].iov_len;
+            }
+            d->u.buf = buf;
+            d->buf_start = 0;
+            d->buf_end = n;
+            break;
+        }
+        mt->bytes_out += w;
+        for (; niov && (size_t) w >= iov->iov_len; ++iov, --niov) {
+            w -= iov->iov_len;
+        }
+        if (w) {
+            ++mt->partial_writes;
+            iov->iov_base = (char *) iov->iov_base + w;
+            iov->iov_len -= w;
+        }
+    }
+    frame_out_reset(out);
+    return !d->u.buf;
+}
+
+static inline EchoResult datum_echo_frames(Datum *d)
+{
+    int fd = d->fd;
+
+    if (d->u.buf) {
+        unsigned buf_start = d->buf_start;
+        unsigned buf_end   = d->buf_end;
+        while (buf_start != buf_end) {
+            ssize_t w = write(fd, d->u.buf + buf_start, buf_end - buf_start);
+            if (w < 0) {
+                mt->eagain_out += errno == EAGAIN;
+                return echo_errno_result();
+            }
+            mt->bytes_out += w;
+            mt->partial_writes += (size_t) w != buf_end - buf_start;
+            d->buf_start = (buf_start += w);
+        }
+        pool_free(&fp, d->u.buf);
+        d->u.buf = NULL;
+    }
+
+    FrameOut *out = &fr_out;
+    frame_out_reset(out);
+    for (size_t moved = 0; moved < ECHO_BUDGET;) {
+        char *base = d->in ? d->in : fr_scratch;
+        size_t len = d->in_len;
+        if (!d->in_ready) {
+            ssize_t r = read(fd, base + len, FRAME_BUFSZ - len);
+            switch (r) {
+            case -1:
+                mt->eagain_in += errno == EAGAIN;
+                return echo_errno_result();
+            case 0:
+                return ECHO_CLOSE;
+            }
+            mt->bytes_in += r;
+            d->active = tw_tick;
+            len += r;
+            moved += r;
+        }
+
+        size_t off = 0;
+        bool blocked = false;
+        while (1) {
+            const char *req;
+            size_t req_len, frame_len;
+            int k = frame_next(base + off, len - off, &req, &req_len, &frame_len);
+            if (k < 0) {
+                frame_out_reset(out);
+                return ECHO_CLOSE;
+            }
+            if (!k) {
+                break;
+            }
+            if (!frame_out_room(out)) {
+                int f = frame_flush(d, out);
+                if (f < 0) {
+                    return ECHO_CLOSE;
+                }
+                if (!f) {
+                    blocked = true;
+                    break;
+                }
+            }
+            if (!frame_handler->on_frame(d, req, req_len, out)) {
+                frame_out_reset(out);
+                return ECHO_CLOSE;
+            }
+            off += frame_len;
+        }
+        if (!blocked) {
+            int f = frame_flush(d, out);
+            if (f < 0) {
+                return ECHO_CLOSE;
+            }
+            blocked = !f;
+        }
+
+        // keep what is not parsed yet; the output is already copied out
+        size_t rest = len - off;
+        if (rest) {
+            if (!d->in) {
+                d->in = pool_alloc(&fp);
+                memcpy(d->in, base + off, rest);
+            } else if (off) {
+                memmove(d->in, d->in + off, rest);
+            }
+        } else if (d->in) {
+            pool_free(&fp, d->in);
+            d->in = NULL;
+        }
+        d->in_len = rest;
+        d->in_ready = blocked && rest;
+        if (blocked) {
+            return ECHO_WAIT;
+        }
+    }
+    return ECHO_YIELD;
+}
+
+static inline EchoResult datum_echo(Datum *d)
+{
+    if (framing) {
+        return datum_echo_frames(d);
+    }
+    return d->pipe_rd >= 0 ? datum_echo_splice(d) : datum_echo_buf(d);
+}
+
+//-----------------------------------------------------------------------------
+// ready queue (one per thread)
+//
+// Datums that yielded are serviced round-robin after each epoll batch. While a datum is
+// queued, its events are ignored: it is going to be serviced anyway.
+
+static __thread Datum *rq_head, *rq_tail;
+
+static void rq_push(Datum *d)
+{
+    d->queued = true;
+    d->next_ready = NULL;
+    if (rq_tail) {
+        rq_tail->next_ready = d;
+    } else {
+        rq_head = d;
+    }
+    rq_tail = d;
+}
+
+static Datum * rq_pop(void)
+{
+    Datum *d = rq_head;
+    rq_head = d->next_ready;
+    if (!rq_head) {
+        rq_tail = NULL;
+    }
+    d->queued = false;
+    return d;
+}
+
+//-----------------------------------------------------------------------------
+
+enum { EPEVBUF_SIZE = 1024 };
+
+// Returns false on a fatal error.
+static bool srv_epoll_close(int efd, Datum *datum)
+{
+    int fd = datum_fd(datum);
+    if (epoll_ctl(efd, EPOLL_CTL_DEL, fd, NULL) < 0) {
+        perror("epoll_ctl (EPOLL_CTL_DEL on client fd)");
+        return false;
+    }
+    if (close(fd) < 0) {
+        perror("close");
+        // note: no return
+    }
+    ++mt->closes;
+    datum_destroy(datum);
+    return true;
+}
+
+// Returns false on a fatal error.
+static bool srv_epoll_service(int efd, Datum *datum)
+{
+    EchoResult r = datum_echo(datum);
+    if (r == ECHO_CLOSE) {
+        return srv_epoll_close(efd, datum);
+    }
+    if (r == ECHO_YIELD) {
+        rq_push(datum);
+    }
+    if (timeouts_enabled()) {
+        bool stalling = datum->u.buf || datum->pipe_len;
+        if (stalling != datum->stalling) {
+            datum->stalling = stalling;
+            datum->stalled = tw_tick;
+        }
+        tw_arm(datum);
+    }
+    return true;
+}
+
+enum { ACCEPT_BUDGET = 64 };
+enum { ACCEPT_BACKOFF_MS = 50 }; // before accepting again when out of descriptors
+
+static bool shared_listener;
+
+// Accepts up to ACCEPT_BUDGET connections. Returns 0 if the backlog is drained, 1 if it may
+// not be, 2 if it has to wait for descriptors (or memory) to be freed, and -1 on a fatal error.
+static int srv_epoll_accept(int efd, int sfd)
+{
+    for (int i = 0; i < ACCEPT_BUDGET; ++i) {
+        int cfd = accept4(sfd, NULL, NULL, SOCK_NONBLOCK);
+        if (cfd < 0) {
+            switch (errno) {
+            case EAGAIN:
+                return 0;
+            case ECONNABORTED: // the client went away before we got to it
+            case EPROTO:
+            case EINTR:
+                continue;
+            case EMFILE:
+            case ENFILE:
+            case ENOBUFS:
+            case ENOMEM:
+                // out of descriptors or memory for now: the backlog waits until a connection
+                // closes or ACCEPT_BACKOFF_MS have passed
+                return 2;
+            }
+            perror("accept4");
+            return -1;
+        }
+        ++mt->accepts;
+        if (epoll_ctl(efd, EPOLL_CTL_ADD, cfd, &(struct epoll_event) {
+                .events = EPOLLIN | EPOLLOUT | EPOLLET,
+                .data.ptr = datum_create(cfd),
+            }) < 0)
+        {
+            perror("epoll_ctl (EPOLL_CTL_ADD on client fd)");
+            return -1;
+        }
+    }
+    return 1;
+}
+
+void srv_epoll_run(int sfd)
+{
+    if (signal(SIGPIPE, SIG_IGN) == SIG_ERR) {
+        perror("signal");
+        return;
+    }
+    struct epoll_event *epevbuf = xmalloc(EPEVBUF_SIZE, sizeof(struct epoll_event));
+    int efd = epoll_create1(0);
+    if (efd < 0) {
+        perror("epoll_create1");
+        return;
+    }
+    if (make_nonblock(sfd) < 0) {
+        perror("make_nonblock (on server socket fd)");
+        return;
+    }
+    // with a listener shared between threads, wake up only one of them per connection
+    if (epoll_ctl(efd, EPOLL_CTL_ADD, sfd, &(struct epoll_event) {
+            .events = EPOLLIN | EPOLLET | (shared_listener ? EPOLLEXCLUSIVE : 0),
+            .data.ptr = NULL,
+        }) < 0)
+    {
+        perror("epoll_ctl (EPOLL_CTL_ADD on server socket fd)");
+        return;
+    }
+    tw.now = tw_tick = tw_clock();
+    // the listener may have more connections than the last wakeup accepted
+    bool accept_pending = false;
+    // out of descriptors: when to accept again, and the closes seen at the time
+    uint64_t accept_retry = UINT64_MAX;
+    uint64_t accept_closes = 0;
+    while (1) {
+        // if some datums are still ready, or some connections are still to be accepted, only
+        // collect the events, do not wait for them.
+        int timeout = -1;
+        if (rq_head || accept_pending) {
+            timeout = 0;
+        } else {
+            uint64_t next = sal_next_release();
+            if (accept_retry < next) {
+                next = accept_retry;
+            }
+            if (timeouts_enabled()) {
+                uint64_t t = tw_next_tick();
+                if (t < next) {
+                    next = t;
+                }
+            }
+            if (next != UINT64_MAX) {
+                uint64_t now = tw_clock();
+                timeout = next <= now ? 0 : next - now > INT_MAX ? INT_MAX : (int) (next - now);
+            }
+        }
+        int nfds = epoll_wait(efd, epevbuf, EPEVBUF_SIZE, timeout);
+        if (nfds < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("epoll_wait");
+            return;
+        }
+        metrics_batch(nfds);
+        if (timeouts_enabled()) {
+            tw_tick = tw_clock();
+        }
+        // datums that yield while the queue is serviced go behind this one.
+        Datum *last_ready = rq_tail;
+        for (int i = 0; i < nfds; ++i) {
+            Datum *datum = epevbuf[i].data.ptr;
+            if (datum) {
+                if (!datum->queued && !srv_epoll_service(efd, datum)) {
+                    return;
+                }
+            } else {
+                accept_pending = true;
+            }
+        }
+        if (last_ready) {
+            Datum *datum;
+            do {
+                datum = rq_pop();
+                if (!srv_epoll_service(efd, datum)) {
+                    return;
+                }
+            } while (datum != last_ready);
+        }
+        if (accept_retry != UINT64_MAX
+            && (mt->closes != accept_closes || tw_clock() >= accept_retry))
+        {
+            accept_pending = true;
+            accept_retry = UINT64_MAX;
+        }
+        if (accept_pending) {
+            // after the echo work of the batch, so that a connection storm cannot delay it
+            int r = srv_epoll_accept(efd, sfd);
+            if (r < 0) {
+                return;
+            }
+            accept_pending = r == 1;
+            if (r == 2) {
+                accept_retry = tw_clock() + ACCEPT_BACKOFF_MS;
+                accept_closes = mt->closes;
+            }
+        }
+        if (timeouts_enabled()) {
+            // after the events, so that the datums they revived are not closed
+            for (Datum *datum = tw_advance(tw_tick); datum;) {
+                Datum *next = datum->tw_next;
+                if (datum->queued) {
+                    // cannot happen, as a datum only yields right after a read; but closing
+                    // it would leave it in the ready queue.
+                    tw_arm(datum);
+                    datum = next;
+                    continue;
+                }
+                ++mt->timeouts;
+                if (!srv_epoll_close(efd, datum)) {
+                    return;
+                }
+                datum = next;
+            }
+        }
+        if (sal_empty.head) {
+            sal_release(tw_clock());
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+// io_uring backend
+//
+// Set up with raw syscalls, no liburing. Accepts and receives are multishot; receives pick
+// their buffers from a provided buffer ring. A connection has at most one send in flight,
+// and the buffers received meanwhile queue up behind it, so the echo stays in order. (The
+// send cannot be linked to the receive: the buffer is only known when the receive completes.)
+// All SQEs queued while handling a batch of completions are submitted by the same
+// io_uring_enter that waits for the next batch.
+
+enum {
+    UR_ENTRIES = 4096,
+    UR_NBUFS = 4096, // must be a power of 2
+    UR_BGID = 0,
+};
+
+enum {
+    UOP_ACCEPT,
+    UOP_RECV,
+    UOP_SEND,
+};
+
+#define ur_udata(Fd_, Op_) (((uint64_t) (Fd_) << 2) | (Op_))
+
+typedef struct {
+    int fd;
+    unsigned *sq_head, *sq_tail, *sq_mask;
+    unsigned sq_entries;
+    struct io_uring_sqe *sqes;
+    unsigned sq_local_tail; // SQEs up to here are filled in
+    unsigned sq_submitted;  // SQEs up to here have been handed to the kernel
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_cqe *cqes;
+} Uring;
+
+typedef struct {
+    struct io_uring_buf_ring *br;
+    char *base;
+    unsigned short tail;
+    unsigned short next[UR_NBUFS]; // links of the per-connection queues
+    unsigned len[UR_NBUFS];        // data length of a received buffer
+} UringBufs;
+
+typedef struct {
+    int qhead, qtail;   // queue of received buffers, -1 if empty
+    unsigned send_off;  // how much of the queue head is already sent
+    bool sending;
+    bool closing;
+    bool in_use;
+    int next_starved;   // link in the list of connections waiting for buffers
+} UConn;
+
+static __thread Uring ur;
+static __thread UringBufs *ur_bufs;
+static __thread UConn *ur_conns;
+static __thread size_t ur_nconns;
+static __thread int ur_starved = -1;
+
+static int ur_setup(unsigned entries)
+{
+    struct io_uring_params p = {
+        .flags = IORING_SETUP_CQSIZE,
+        .cq_entries = entries * 4,
+    };
+    int fd = syscall(__NR_io_uring_setup, entries, &p);
+    if (fd < 0) {
+        perror("io_uring_setup");
+        return -1;
+    }
+    size_t sq_sz = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    size_t cq_sz = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    bool single = p.features & IORING_FEAT_SINGLE_MMAP;
+    if (single) {
+        sq_sz = cq_sz = sq_sz > cq_sz ? sq_sz : cq_sz;
+    }
+    char *sq = mmap(NULL, sq_sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                    IORING_OFF_SQ_RING);
+    if (sq == MAP_FAILED) {
+        perror("mmap (SQ ring)");
+        return -1;
+    }
+    char *cq = sq;
+    if (!single) {
+        cq = mmap(NULL, cq_sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                  IORING_OFF_CQ_RING);
+        if (cq == MAP_FAILED) {
+            perror("mmap (CQ ring)");
+            return -1;
+        }
+    }
+    struct io_uring_sqe *sqes = mmap(NULL, p.sq_entries * sizeof(struct io_uring_sqe),
+                                     PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                                     IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        perror("mmap (SQEs)");
+        return -1;
+    }
+    ur = (Uring) {
+        .fd = fd,
+        .sq_head = (unsigned *) (sq + p.sq_off.head),
+        .sq_tail = (unsigned *) (sq + p.sq_off.tail),
+        .sq_mask = (unsigned *) (sq + p.sq_off.ring_mask),
+        .sq_entries = p.sq_entries,
+        .sqes = sqes,
+        .cq_head = (unsigned *) (cq + p.cq_off.head),
+        .cq_tail = (unsigned *) (cq + p.cq_off.tail),
+        .cq_mask = (unsigned *) (cq + p.cq_off.ring_mask),
+        .cqes = (struct io_uring_cqe *) (cq + p.cq_off.cqes),
+    };
+    ur.sq_local_tail = ur.sq_submitted = *ur.sq_tail;
+    // SQE i always goes to slot i
+    unsigned *array = (unsigned *) (sq + p.sq_off.array);
+    for (unsigned i = 0; i < p.sq_entries; ++i) {
+        array[i] = i;
+    }
+    return 0;
+}
+
+static int ur_enter(unsigned wait_nr)
+{
+    __atomic_store_n(ur.sq_tail, ur.sq_local_tail, __ATOMIC_RELEASE);
+    int r = syscall(__NR_io_uring_enter, ur.fd, ur.sq_local_tail - ur.sq_submitted, wait_nr,
+                    wait_nr ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+    if (r >= 0) {
+        ur.sq_submitted += r;
+    }
+    return r;
+}
+
+static struct io_uring_sqe * ur_sqe(void)
+{
+    while (ur.sq_local_tail - __atomic_load_n(ur.sq_head, __ATOMIC_ACQUIRE) == ur.sq_entries) {
+        if (ur_enter(0) < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+            perror("io_uring_enter");
+            abort();
+        }
+    }
+    struct io_uring_sqe *sqe = &ur.sqes[ur.sq_local_tail++ & *ur.sq_mask];
+    memset(sqe, 0, sizeof(*sqe));
+    return sqe;
+}
+
+static int ur_bufs_setup(void)
+{
+    UringBufs *b = xmalloc(1, sizeof(UringBufs));
+    b->br = mmap(NULL, UR_NBUFS * sizeof(struct io_uring_buf), PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (b->br == MAP_FAILED) {
+        perror("mmap (buffer ring)");
+        return -1;
+    }
+    struct io_uring_buf_reg reg = {
+        .ring_addr = (uintptr_t) b->br,
+        .ring_entries = UR_NBUFS,
+        .bgid = UR_BGID,
+    };
+    if (syscall(__NR_io_uring_register, ur.fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        perror("io_uring_register (IORING_REGISTER_PBUF_RING)");
+        return -1;
+    }
+    b->base = xmalloc(UR_NBUFS, BUFSZ);
+    b->tail = 0;
+    ur_bufs = b;
+    return 0;
+}
+
+static void ur_arm_recv(int fd)
+{
+    struct io_uring_sqe *sqe = ur_sqe();
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = fd;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = UR_BGID;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->user_data = ur_udata(fd, UOP_RECV);
+}
+
+static void ur_buf_recycle(unsigned bid)
+{
+    UringBufs *b = ur_bufs;
+    struct io_uring_buf *buf = &b->br->bufs[b->tail & (UR_NBUFS - 1)];
+    buf->addr = (uintptr_t) (b->base + (size_t) bid * BUFSZ);
+    buf->len = BUFSZ;
+    buf->bid = bid;
+    __atomic_store_n(&b->br->tail, ++b->tail, __ATOMIC_RELEASE);
+
+    // a connection that ran out of buffers can receive again.
+    if (ur_starved >= 0) {
+        int fd = ur_starved;
+        ur_starved = ur_conns[fd].next_starved;
+        ur_arm_recv(fd);
+    }
+}
+
+static void ur_send_head(int fd)
+{
+    UConn *c = &ur_conns[fd];
+    unsigned bid = c->qhead;
+    struct io_uring_sqe *sqe = ur_sqe();
+    sqe->opcode = IORING_OP_SEND;
+    sqe->fd = fd;
+    sqe->addr = (uintptr_t) (ur_bufs->base + (size_t) bid * BUFSZ + c->send_off);
+    sqe->len = ur_bufs->len[bid] - c->send_off;
+    sqe->user_data = ur_udata(fd, UOP_SEND);
+    c->sending = true;
+}
+
+static void ur_conn_close(int fd)
+{
+    UConn *c = &ur_conns[fd];
+    for (int bid = c->qhead; bid >= 0;) {
+        int next = bid == c->qtail ? -1 : ur_bufs->next[bid];
+        ur_buf_recycle(bid);
+        bid = next;
+    }
+    c->in_use = false;
+    if (close(fd) < 0) {
+        perror("close");
+        // note: no return
+    }
+    ++mt->closes;
+    --mt->live_slots;
+}
+
+static void ur_arm_accept(int sfd)
+{
+    struct io_uring_sqe *sqe = ur_sqe();
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = sfd;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->user_data = ur_udata(sfd, UOP_ACCEPT);
+}
+
+static void ur_handle(int sfd, const struct io_uring_cqe *cqe)
+{
+    const int fd = cqe->user_data >> 2;
+    const int res = cqe->res;
+    const bool more = cqe->flags & IORING_CQE_F_MORE;
+
+    switch (cqe->user_data & 3) {
+    case UOP_ACCEPT:
+        if (res >= 0) {
+            if ((size_t) res >= ur_nconns) {
+                size_t n = ur_nconns ? ur_nconns : 1024;
+                while (n <= (size_t) res) {
+                    n *= 2;
+                }
+                UConn *conns = xmalloc(n, sizeof(UConn));
+                memcpy(conns, ur_conns, ur_nconns * sizeof(UConn));
+                memset(conns + ur_nconns, 0, (n - ur_nconns) * sizeof(UConn));
+                free(ur_conns);
+                ur_conns = conns;
+                ur_nconns = n;
+            }
+            ur_conns[res] = (UConn) {
+                .qhead = -1,
+                .qtail = -1,
+                .in_use = true,
+                .next_starved = -1,
+            };
+            ++mt->accepts;
+            ++mt->live_slots;
+            ur_arm_recv(res);
+        } else {
+            fprintf(stderr, "accept: %s\n", strerror(-res));
+        }
+        if (!more) {
+            ur_arm_accept(sfd);
+        }
+        break;
+
+    case UOP_RECV: {
+        UConn *c = &ur_conns[fd];
+        if (res > 0) {
+            unsigned bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+            ur_bufs->len[bid] = res;
+            mt->bytes_in += res;
+            if (c->closing) {
+                ur_buf_recycle(bid);
+            } else {
+                if (c->qtail >= 0) {
+                    ur_bufs->next[c->qtail] = bid;
+                } else {
+                    c->qhead = bid;
+                }
+                c->qtail = bid;
+                if (!c->sending) {
+                    c->send_off = 0;
+                    ur_send_head(fd);
+                }
+            }
+            if (!more) {
+                ur_arm_recv(fd);
+            }
+        } else if (res == -ENOBUFS) {
+            // wait until some buffer is recycled
+            c->next_starved = ur_starved;
+            ur_starved = fd;
+        } else if (!more) {
+            // EOF or error; the receive is over.
+            if (c->sending) {
+                c->closing = true;
+            } else {
+                ur_conn_close(fd);
+            }
+        }
+        break;
+    }
+
+    case UOP_SEND: {
+        UConn *c = &ur_conns[fd];
+        c->sending = false;
+        if (c->closing) {
+            ur_conn_close(fd);
+            break;
+        }
+        if (res < 0) {
+            // the peer is gone; drop the queue and let the receive finish, it closes the fd.
+            shutdown(fd, SHUT_RDWR);
+            c->closing = true;
+            for (int bid = c->qhead; bid >= 0;) {
+                int next = bid == c->qtail ? -1 : ur_bufs->next[bid];
+                ur_buf_recycle(bid);
+                bid = next;
+            }
+            c->qhead = c->qtail = -1;
+            break;
+        }
+        unsigned bid = c->qhead;
+        mt->bytes_out += res;
+        mt->partial_writes += (unsigned) res != ur_bufs->len[bid] - c->send_off;
+        c->send_off += res;
+        if (c->send_off == ur_bufs->len[bid]) {
+            c->qhead = bid == (unsigned) c->qtail ? -1 : ur_bufs->next[bid];
+            if (c->qhead < 0) {
+                c->qtail = -1;
+            }
+            c->send_off = 0;
+            ur_buf_recycle(bid);
+        }
+        if (c->qhead >= 0) {
+            ur_send_head(fd);
+        }
+        break;
+    }
+    }
+}
+
+void srv_uring_run(int sfd)
+{
+    if (signal(SIGPIPE, SIG_IGN) == SIG_ERR) {
+        perror("signal");
+        return;
+    }
+    if (ur_setup(UR_ENTRIES) < 0 || ur_bufs_setup() < 0) {
+        return;
+    }
+    for (unsigned bid = 0; bid < UR_NBUFS; ++bid) {
+        ur_buf_recycle(bid);
+    }
+    ur_arm_accept(sfd);
+    while (1) {
+        if (ur_enter(1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("io_uring_enter");
+            return;
+        }
+        unsigned head = *ur.cq_head;
+        unsigned tail = __atomic_load_n(ur.cq_tail, __ATOMIC_ACQUIRE);
+        metrics_batch(tail - head);
+        for (; head != tail; ++head) {
+            ur_handle(sfd, &ur.cqes[head & *ur.cq_mask]);
+        }
+        __atomic_store_n(ur.cq_head, head, __ATOMIC_RELEASE);
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+static int make_listener(unsigned long port, bool reuseport)
+{
+    int sfd = socket(PF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (sfd < 0) {
+        perror("socket");
+        return -1;
+    }
+    if (reuseport && setsockopt(sfd, SOL_SOCKET, SO_REUSEPORT, &(int) {1}, sizeof(int)) < 0) {
+        perror("setsockopt (SO_REUSEPORT)");
+        goto fail;
+    }
+    struct sockaddr_in sa = {
+        .sin_family = PF_INET,
+        .sin_port = htons(port),
+        .sin_addr.s_addr = htonl(INADDR_ANY),
+    };
+    if (bind(sfd, (struct sockaddr *) &sa, sizeof(sa)) < 0) {
+        perror("bind");
+        goto fail;
+    }
+    if (listen(sfd, SOMAXCONN) < 0) {
+        perror("listen");
+        goto fail;
+    }
+    return sfd;
+
+fail:
+    close(sfd);
+    return -1;
+}
+
+typedef struct {
+    pthread_t thread;
+    int sfd;
+    int cpu; // -1 if not pinned
+    Metrics *metrics;
+} Worker;
+
+static bool use_uring;
+
+static void * worker_main(void *arg)
+{
+    Worker *w = arg;
+    mt = w->metrics;
+    if (w->cpu >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(w->cpu, &set);
+        int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        if (err) {
+            fprintf(stderr, "pthread_setaffinity_np: %s\n", strerror(err));
+        }
+    }
+    if (use_uring) {
+        srv_uring_run(w->sfd);
+    } else {
+        srv_epoll_run(w->sfd);
+    }
+    // the event loop only returns on error
+    exit(1);
+}
+
+// Returns the 'i'-th CPU (modulo their number) this process is allowed to run on.
+static int nth_allowed_cpu(unsigned i)
+{
+    cpu_set_t set;
+    if (sched_getaffinity(0, sizeof(set), &set) < 0 || !CPU_COUNT(&set)) {
+        return i;
+    }
+    i %= CPU_COUNT(&set);
+    for (int cpu = 0;; ++cpu) {
+        if (CPU_ISSET(cpu, &set) && !i--) {
+            return cpu;
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+// Creates the shared memory object 'name' for 'nthreads' threads. Returns NULL on error.
+static MetricsShm * metrics_shm_create(const char *name, unsigned long nthreads)
+{
+    size_t size = sizeof(MetricsShm) + nthreads * sizeof(Metrics);
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        perror("shm_open");
+        return NULL;
+    }
+    if (ftruncate(fd, size) < 0) {
+        perror("ftruncate");
+        close(fd);
+        return NULL;
+    }
+    MetricsShm *shm = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (shm == MAP_FAILED) {
+        perror("mmap");
+        return NULL;
+    }
+    shm->nthreads = nthreads;
+    __atomic_store_n(&shm->magic, METRICS_MAGIC, __ATOMIC_RELEASE);
+    return shm;
+}
+
+#define metrics_load(Field_) __atomic_load_n(&(Field_), __ATOMIC_RELAXED)
+
+static int stats_main(const char *name)
+{
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) {
+        perror("shm_open");
+        return 1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        perror("fstat");
+        return 1;
+    }
+    if ((size_t) st.st_size < sizeof(MetricsShm)) {
+        fprintf(stderr, "'%s' does not hold server metrics.\n", name);
+        return 1;
+    }
+    const MetricsShm *shm = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (shm == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+    if (__atomic_load_n(&shm->magic, __ATOMIC_ACQUIRE) != METRICS_MAGIC ||
+        shm->nthreads > (st.st_size - sizeof(MetricsShm)) / sizeof(Metrics))
+    {
+        fprintf(stderr, "'%s' does not hold server metrics.\n", name);
+        return 1;
+    }
+
+    printf("%6s %10s %10s %10s %10s %8s %14s %14s %10s %10s %10s\n", "thread", "accepts",
+           "closes", "timeouts", "live", "chunks", "bytes_in", "bytes_out", "eagain_in",
+           "eagain_out", "partial_w");
+    Metrics total = {0};
+    for (uint64_t i = 0; i <= shm->nthreads; ++i) {
+        Metrics m;
+        if (i < shm->nthreads) {
+            const Metrics *src = &shm->threads[i];
+            m = (Metrics) {
+                .accepts = metrics_load(src->accepts),
+                .closes = metrics_load(src->closes),
+                .timeouts = metrics_load(src->timeouts),
+                .live_slots = metrics_load(src->live_slots),
+                .chunks = metrics_load(src->chunks),
+                .bytes_in = metrics_load(src->bytes_in),
+                .bytes_out = metrics_load(src->bytes_out),
+                .eagain_in = metrics_load(src->eagain_in),
+                .eagain_out = metrics_load(src->eagain_out),
+                .partial_writes = metrics_load(src->partial_writes),
+            };
+            for (int j = 0; j < METRICS_NBATCHES; ++j) {
+                m.batches[j] = metrics_load(src->batches[j]);
+                total.batches[j] += m.batches[j];
+            }
+            total.accepts += m.accepts;
+            total.closes += m.closes;
+            total.timeouts += m.timeouts;
+            total.live_slots += m.live_slots;
+            total.chunks += m.chunks;
+            total.bytes_in += m.bytes_in;
+            total.bytes_out += m.bytes_out;
+            total.eagain_in += m.eagain_in;
+            total.eagain_out += m.eagain_out;
+            total.partial_writes += m.partial_writes;
+            printf("%6llu", (unsigned long long) i);
+        } else {
+            m = total;
+            printf("%6s", "total");
+        }
+        printf(" %10llu %10llu %10llu %10llu %8llu %14llu %14llu %10llu %10llu %10llu\n",
+               (unsigned long long) m.accepts, (unsigned long long) m.closes,
+               (unsigned long long) m.timeouts, (unsigned long long) m.live_slots,
+               (unsigned long long) m.chunks, (unsigned long long) m.bytes_in,
+               (unsigned long long) m.bytes_out, (unsigned long long) m.eagain_in,
+               (unsigned long long) m.eagain_out, (unsigned long long) m.partial_writes);
+    }
+    printf("\nevents per wakeup:\n");
+    for (int j = 0; j < METRICS_NBATCHES; ++j) {
+        unsigned long lo = j ? 1ul << (j - 1) : 0;
+        unsigned long hi = j ? (1ul << j) - 1 : 0;
+        if (j == METRICS_NBATCHES - 1) {
+            printf("  %5lu+     %14llu\n", lo, (unsigned long long) total.batches[j]);
+        } else {
+            printf("  %5lu-%-5lu %14llu\n", lo, hi, (unsigned long long) total.batches[j]);
+        }
+    }
+    return 0;
+}
+
+//-----------------------------------------------------------------------------
+
+static void usage(void)
+{
+    fprintf(stderr, "USAGE: srv_epoll [-t THREADS] [-x] [-c] [-u | -s | -f FRAMING] [-i SECS]\n"
+                    "                 [-w SECS] [-H] [-m NAME] PORT\n"
+                    "       srv_epoll stats NAME\n"
+                    "  -t THREADS  run THREADS event loops, each with its own SO_REUSEPORT\n"
+                    "              listening socket (default: 1)\n"
+                    "  -x          share one listening socket between the threads instead, each\n"
+                    "              waiting on it with EPOLLEXCLUSIVE\n"
+                    "  -c          pin every event loop thread to its own CPU\n"
+                    "  -u          use io_uring instead of epoll\n"
+                    "  -s          echo with splice() through a pipe per connection\n"
+                    "  -f FRAMING  split the input into frames and echo every frame separately;\n"
+                    "              FRAMING is 'len' (4-byte big-endian length, then the payload)\n"
+                    "              or 'line' (up to a newline)\n"
+                    "  -i SECS     close connections that have sent nothing for SECS seconds\n"
+                    "  -w SECS     close connections that have not taken their echoed data for\n"
+                    "              SECS seconds\n"
+                    "  -H          allocate connection slots in 2 MiB chunks backed by\n"
+                    "              transparent huge pages\n"
+                    "  -m NAME     publish per-thread counters in the shared memory object NAME\n"
+                    "              (e.g. /srv_epoll), for 'srv_epoll stats NAME' to read\n");
+    exit(2);
+}
+
+static bool parse_ulong(const char *s, unsigned long *out)
+{
+    errno = 0;
+    char *endptr;
+    *out = strtoul(s, &endptr, 10);
+    return !errno && endptr != s && *endptr == '\0';
+}
+
+int main(int argc, char **argv)
+{
+    if (argc == 3 && strcmp(argv[1], "stats") == 0) {
+        return stats_main(argv[2]);
+    }
+
+    unsigned long nthreads = 1;
+    bool pin = false;
+    const char *metrics_name = NULL;
+    for (int c; (c = getopt(argc, argv, "t:xcusf:i:w:Hm:")) != -1;) {
+        switch (c) {
+        case 't':
+            if (!parse_ulong(optarg, &nthreads) || nthreads == 0 || nthreads > 1024) {
+                fprintf(stderr, "THREADS is not a valid number of threads.\n");
+                usage();
+            }
+            break;
+        case 'x':
+            shared_listener = true;
+            break;
+        case 'c':
+            pin = true;
+            break;
+        case 'u':
+            use_uring = true;
+            break;
+        case 's':
+            use_splice = true;
+            break;
+        case 'f':
+            if (strcmp(optarg, "len") == 0) {
+                framing = FRAMING_LEN;
+            } else if (strcmp(optarg, "line") == 0) {
+                framing = FRAMING_LINE;
+            } else {
+                fprintf(stderr, "FRAMING must be 'len' or 'line'.\n");
+                usage();
+            }
+            break;
+        case 'i':
+        case 'w': {
+            unsigned long secs;
+            if (!parse_ulong(optarg, &secs) || secs == 0 || secs > 24 * 60 * 60) {
+                fprintf(stderr, "SECS must be from 1 to %d.\n", 24 * 60 * 60);
+                usage();
+            }
+            *(c == 'i' ? &idle_timeout : &stall_timeout) = secs * 1000;
+            break;
+        }
+        case 'H':
+            sal_hugepages = true;
+            sal_chunk_size = 2 * 1024 * 1024;
+            break;
+        case 'm':
+            metrics_name = optarg;
+            break;
+        default:
+            usage();
+        }
+    }
+    if (argc - optind != 1) {
+        usage();
+    }
+    if (use_uring + use_splice + (framing != FRAMING_NONE) > 1) {
+        fprintf(stderr, "-u, -s and -f cannot be combined.\n");
+        usage();
+    }
+    if (use_uring && shared_listener) {
+        fprintf(stderr, "-x is not supported with -u.\n");
+        usage();
+    }
+    if (use_uring && timeouts_enabled()) {
+        fprintf(stderr, "-i and -w are not supported with -u.\n");
+        usage();
+    }
+    unsigned long port;
+    if (!parse_ulong(argv[optind], &port)) {
+        fprintf(stderr, "PORT is not an integer.\n");
+        usage();
+    }
+    if (port == 0 || port > 65535) {
+        fprintf(stderr, "PORT is not a valid port number.\n");
+        usage();
+    }
+
+    Metrics *metrics;
+    if (metrics_name) {
+        MetricsShm *shm = metrics_shm_create(metrics_name, nthreads);
+        if (!shm) {
+            return 1;
+        }
+        metrics = shm->threads;
+    } else {
+        metrics = aligned_alloc(_Alignof(Metrics), nthreads * sizeof(Metrics));
+        if (!metrics) {
+            fprintf(stderr, "Out of memory.\n");
+            return 1;
+        }
+        memset(metrics, 0, nthreads * sizeof(Metrics));
+    }
+
+    Worker *workers = xmalloc(nthreads, sizeof(Worker));
+    for (unsigned long i = 0; i < nthreads; ++i) {
+        if (shared_listener && i) {
+            workers[i].sfd = workers[0].sfd;
+        } else {
+            workers[i].sfd = make_listener(port, nthreads > 1 && !shared_listener);
+        }
+        if (workers[i].sfd < 0) {
+            return 1;
+        }
+        workers[i].cpu = pin ? nth_allowed_cpu(i) : -1;
+        workers[i].metrics = &metrics[i];
+    }
+    for (unsigned long i = 1; i < nthreads; ++i) {
+        int err = pthread_create(&workers[i].thread, NULL, worker_main, &workers[i]);
+        if (err) {
+            fprintf(stderr, "pthread_create: %s\n", strerror(err));
+            return 1;
+        }
     }
-    srv_epoll_run(sfd);
+    worker_main(&workers[0]);
     return 1;
 }
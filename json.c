@@ -1,5 +1,13 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
 #include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 typedef enum {
     JTT_MAP_START,
@@ -16,6 +24,7 @@ typedef enum {
 
     JTT_ERROR,
     JTT_EOT,
+    JTT_MORE, // JsonStream only: the chunk is used up, feed the next one
 } JsonTokenType;
 
 JsonTokenType
@@ -103,3 +112,2771 @@ json_skip(const char **buf, const char *end)
         }
     } while (level);
 }
+
+//-----------------------------------------------------------------------------
+// Stage 1: structural indexing.
+//
+// The input is classified 64 bytes at a time into bitmaps (bit i is byte i of the block).
+// From those, the escape and in-string masks are computed without branching, as in
+// simdjson: a quote is real unless preceded by an odd run of backslashes, and the prefix
+// XOR of the real quotes marks the bytes inside strings. What is left is a bitmap of the
+// positions where tokens start -- brackets outside strings, real quotes (both the opening
+// and the closing one) and the first byte of every scalar. JsonIter turns it into an array
+// of positions, a window at a time, and jumps from one to the next instead of looking at
+// every byte. It pays off with many short tokens (numbers above all); a long string costs
+// json_advance() only a memchr(), which the classifier cannot beat, so inside strings the
+// window skips ahead with memchr() too.
+
+typedef struct {
+    uint64_t backslash;
+    uint64_t quote;
+    uint64_t bracket; // {}[]
+    uint64_t open;    // {[
+    uint64_t sep;     // :,
+    uint64_t ws;
+} JsonBlockMasks;
+
+typedef void (*JsonClassifyFunc)(const unsigned char *p, JsonBlockMasks *m);
+
+enum {
+    JC_BACKSLASH = 1,
+    JC_QUOTE = 2,
+    JC_BRACKET = 4,
+    JC_SEP = 8,
+    JC_WS = 16,
+    JC_OPEN = 32,
+};
+
+static const unsigned char json_class_table[256] = {
+    ['\\'] = JC_BACKSLASH,
+    ['"'] = JC_QUOTE,
+    ['{'] = JC_BRACKET | JC_OPEN, ['}'] = JC_BRACKET,
+    ['['] = JC_BRACKET | JC_OPEN, [']'] = JC_BRACKET,
+    [':'] = JC_SEP, [','] = JC_SEP,
+    [' '] = JC_WS, ['\t'] = JC_WS, ['\n'] = JC_WS, ['\r'] = JC_WS,
+};
+
+static void
+json_classify_scalar(const unsigned char *p, JsonBlockMasks *m)
+{
+    uint64_t bs = 0, q = 0, br = 0, op = 0, sep = 0, ws = 0;
+    for (int i = 0; i < 64; ++i) {
+        const uint64_t c = json_class_table[p[i]];
+        bs  |= (c & 1) << i;
+        q   |= ((c >> 1) & 1) << i;
+        br  |= ((c >> 2) & 1) << i;
+        op  |= ((c >> 5) & 1) << i;
+        sep |= ((c >> 3) & 1) << i;
+        ws  |= ((c >> 4) & 1) << i;
+    }
+    *m = (JsonBlockMasks) {bs, q, br, op, sep, ws};
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+
+// '[' and '{' (also ']' and '}') only differ in bit 0x20, so each pair takes one compare.
+
+__attribute__((target("sse2")))
+static void
+json_classify_sse2(const unsigned char *p, JsonBlockMasks *m)
+{
+    *m = (JsonBlockMasks) {0};
+    for (int i = 0; i < 4; ++i) {
+        const __m128i v = _mm_loadu_si128((const __m128i *) (p + 16 * i));
+        const __m128i v20 = _mm_or_si128(v, _mm_set1_epi8(0x20));
+#define EQ(V_, C_) _mm_cmpeq_epi8(V_, _mm_set1_epi8(C_))
+#define BITS(X_) ((uint64_t) (uint16_t) _mm_movemask_epi8(X_) << (16 * i))
+        m->backslash |= BITS(EQ(v, '\\'));
+        m->quote     |= BITS(EQ(v, '"'));
+        const __m128i op = EQ(v20, '{');
+        m->bracket   |= BITS(_mm_or_si128(op, EQ(v20, '}')));
+        m->open      |= BITS(op);
+        m->sep       |= BITS(_mm_or_si128(EQ(v, ':'), EQ(v, ',')));
+        m->ws        |= BITS(_mm_or_si128(_mm_or_si128(EQ(v, ' '), EQ(v, '\t')),
+                                          _mm_or_si128(EQ(v, '\n'), EQ(v, '\r'))));
+#undef BITS
+#undef EQ
+    }
+}
+
+__attribute__((target("avx2")))
+static void
+json_classify_avx2(const unsigned char *p, JsonBlockMasks *m)
+{
+    *m = (JsonBlockMasks) {0};
+    for (int i = 0; i < 2; ++i) {
+        const __m256i v = _mm256_loadu_si256((const __m256i *) (p + 32 * i));
+        const __m256i v20 = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+#define EQ(V_, C_) _mm256_cmpeq_epi8(V_, _mm256_set1_epi8(C_))
+#define BITS(X_) ((uint64_t) (uint32_t) _mm256_movemask_epi8(X_) << (32 * i))
+        m->backslash |= BITS(EQ(v, '\\'));
+        m->quote     |= BITS(EQ(v, '"'));
+        const __m256i op = EQ(v20, '{');
+        m->bracket   |= BITS(_mm256_or_si256(op, EQ(v20, '}')));
+        m->open      |= BITS(op);
+        m->sep       |= BITS(_mm256_or_si256(EQ(v, ':'), EQ(v, ',')));
+        m->ws        |= BITS(_mm256_or_si256(_mm256_or_si256(EQ(v, ' '), EQ(v, '\t')),
+                                             _mm256_or_si256(EQ(v, '\n'), EQ(v, '\r'))));
+#undef BITS
+#undef EQ
+    }
+}
+#endif
+
+static JsonClassifyFunc json_classify;
+
+static JsonClassifyFunc
+json_classify_pick(void)
+{
+    if (!json_classify) {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+            json_classify = json_classify_avx2;
+        } else if (__builtin_cpu_supports("sse2")) {
+            json_classify = json_classify_sse2;
+        } else
+#endif
+        {
+            json_classify = json_classify_scalar;
+        }
+    }
+    return json_classify;
+}
+
+// Prefix XOR: bit i of the result is the XOR of bits 0..i of 'x'.
+static inline uint64_t
+json_prefix_xor(uint64_t x)
+{
+    x ^= x << 1;
+    x ^= x << 2;
+    x ^= x << 4;
+    x ^= x << 8;
+    x ^= x << 16;
+    x ^= x << 32;
+    return x;
+}
+
+// What has to be carried from one block to the next.
+typedef struct {
+    uint64_t escaped;   // 1 if the first byte of the next block is escaped
+    uint64_t in_string; // all ones if the next block starts inside a string
+    uint64_t scalar;    // 1 if the last byte was part of a scalar
+} JsonStage1Carry;
+
+// Bytes escaped by a backslash. From simdjson's find_escaped_branchless().
+static inline uint64_t
+json_escaped(uint64_t backslash, JsonStage1Carry *c)
+{
+    const uint64_t even = 0x5555555555555555ull;
+    backslash &= ~c->escaped;
+    const uint64_t follows_escape = backslash << 1 | c->escaped;
+    const uint64_t odd_starts = backslash & ~even & ~follows_escape;
+    uint64_t even_starts;
+    c->escaped = __builtin_add_overflow(odd_starts, backslash, &even_starts);
+    return (even ^ (even_starts << 1)) & follows_escape;
+}
+
+// Computes the real quotes and the in-string mask (opening quote included, closing quote
+// not) of a block.
+static inline uint64_t
+json_in_string(const JsonBlockMasks *m, JsonStage1Carry *c, uint64_t *quotes)
+{
+    *quotes = m->quote & ~json_escaped(m->backslash, c);
+    const uint64_t in_string = json_prefix_xor(*quotes) ^ c->in_string;
+    c->in_string = (uint64_t) ((int64_t) in_string >> 63);
+    return in_string;
+}
+
+// Returns the token start bitmap of a block.
+static inline uint64_t
+json_structurals(const JsonBlockMasks *m, JsonStage1Carry *c)
+{
+    uint64_t quotes;
+    const uint64_t in_string = json_in_string(m, c, &quotes);
+    const uint64_t scalar = ~(m->bracket | m->sep | m->ws | m->quote | in_string);
+    const uint64_t scalar_start = scalar & ~(scalar << 1 | c->scalar);
+    c->scalar = scalar >> 63;
+    return (m->bracket & ~in_string) | quotes | scalar_start;
+}
+
+// Classifies the block at 'p', of which only 'n' bytes (at most 64) are part of the input.
+static inline void
+json_classify_block(const char *p, size_t n, JsonBlockMasks *m)
+{
+    if (n >= 64) {
+        json_classify((const unsigned char *) p, m);
+    } else {
+        unsigned char tail[64];
+        memcpy(tail, p, n);
+        memset(tail + n, ' ', 64 - n);
+        json_classify(tail, m);
+    }
+}
+
+enum { JSON_ITER_WINDOW = 4096 }; // bytes indexed at a time, a multiple of 64
+
+typedef struct {
+    const char *cur;    // just past the last token
+    const char *end;
+    const char *next;   // the next window to index
+    const char *window; // the window 'pos' is relative to
+    size_t npos;
+    size_t ipos;        // the next entry of 'pos' to return
+    JsonStage1Carry carry;
+    uint16_t pos[JSON_ITER_WINDOW]; // token starts and closing quotes in the window
+} JsonIter;
+
+void
+json_iter_init(JsonIter *it, const char *buf, const char *end)
+{
+    json_classify_pick();
+    it->cur = it->next = it->window = buf;
+    it->end = end;
+    it->npos = it->ipos = 0;
+    it->carry = (JsonStage1Carry) {0};
+}
+
+// Returns 1 if the byte at 'p', in a string, is escaped. The backslashes are counted back to
+// 'from', and 'escaped' says whether the byte at 'from' is escaped.
+static inline uint64_t
+json_iter_escaped(const char *from, const char *p, uint64_t escaped)
+{
+    const char *b = p;
+    while (b != from && b[-1] == '\\') {
+        --b;
+    }
+    return ((size_t) (p - b) ^ (b == from ? escaped : 0)) & 1;
+}
+
+// Indexes the next window. Returns 0 at the end of the input.
+static int
+json_iter_fill(JsonIter *it)
+{
+    const size_t left = it->end - it->next;
+    if (!left) {
+        return 0;
+    }
+    const size_t n = left < JSON_ITER_WINDOW ? left : JSON_ITER_WINDOW;
+    const char *w = it->window = it->next;
+    it->npos = it->ipos = 0;
+    for (size_t off = 0; off < n; off += 64) {
+        if (it->carry.in_string) {
+            // The blocks of a string before the block of its closing quote have nothing to
+            // index, and memchr() gets past them faster than the classifier, the same way
+            // json_advance() does. Only the escape carry has to be worked out.
+            const char *from = w + off, *q = from;
+            while ((q = memchr(q, '"', w + n - q))
+                   && json_iter_escaped(from, q, it->carry.escaped)) {
+                ++q;
+            }
+            const size_t to = q ? (size_t) (q - w) & ~(size_t) 63 : n;
+            if (to > off) {
+                it->carry.escaped = json_iter_escaped(from, w + to, it->carry.escaped);
+                if (to == n) {
+                    break;
+                }
+                off = to;
+            }
+        }
+        JsonBlockMasks m;
+        json_classify_block(w + off, n - off, &m);
+        uint64_t bits = json_structurals(&m, &it->carry);
+        while (bits) {
+            it->pos[it->npos++] = off + __builtin_ctzll(bits);
+            bits &= bits - 1;
+        }
+    }
+    it->next += n;
+    return 1;
+}
+
+// Returns the next token start, or NULL at the end of the input.
+static inline const char *
+json_iter_next_start(JsonIter *it)
+{
+    while (it->ipos == it->npos) {
+        if (!json_iter_fill(it)) {
+            return NULL;
+        }
+    }
+    return it->window + it->pos[it->ipos++];
+}
+
+// Returns where the scalar that was just returned ends: before the separators and the
+// whitespace in front of the next entry, which is left for the next call.
+static inline const char *
+json_iter_scalar_end(JsonIter *it)
+{
+    const char *e = json_iter_next_start(it);
+    if (e) {
+        --it->ipos;
+    } else {
+        e = it->end;
+    }
+    // stops at the scalar at the latest
+    while (json_class_table[(unsigned char) e[-1]] & (JC_SEP | JC_WS)) {
+        --e;
+    }
+    return e;
+}
+
+// Same as json_advance(), on the same input, gives the same tokens as long as the input is
+// valid JSON. The current position is 'it->cur'.
+JsonTokenType
+json_iter_advance(JsonIter *it, const char **start)
+{
+    const char *end = it->end;
+    while (1) {
+        const char *s = json_iter_next_start(it);
+        if (!s) {
+            it->cur = end;
+            return JTT_EOT;
+        }
+
+#define RET(Ptr_, Jtt_) it->cur = (Ptr_); return Jtt_
+#define LITERAL(Len_, Jtt_) if (end - s < (Len_)) { RET(s, JTT_ERROR); } RET(s + (Len_), Jtt_)
+
+        switch (*s) {
+            case '{': RET(s + 1, JTT_MAP_START);
+            case '}': RET(s + 1, JTT_MAP_END);
+            case '[': RET(s + 1, JTT_LIST_START);
+            case ']': RET(s + 1, JTT_LIST_END);
+
+            case '"': {
+                if (start) { *start = s; }
+                // the closing quote is the next entry
+                const char *q = json_iter_next_start(it);
+                if (!q) { RET(end, JTT_ERROR); }
+                RET(q + 1, JTT_STRING);
+            }
+
+            case '-':
+            case '0' ... '9':
+                if (start) { *start = s; }
+                RET(json_iter_scalar_end(it), JTT_NUMBER);
+
+            case 't': LITERAL(4, JTT_TRUE);
+            case 'f': LITERAL(5, JTT_FALSE);
+            case 'n': LITERAL(4, JTT_NULL);
+        }
+#undef LITERAL
+#undef RET
+    }
+}
+
+// Moves '*buf', which is inside 'level' containers and not inside a string, past the
+// closing bracket of the outermost one, counting the bracket depth a block at a time with
+// strings masked out. Only the brackets are looked at: the contents are not validated, and
+// an unclosed container skips to 'end'.
+static void
+json_skip_close(const char **buf, const char *end, size_t level)
+{
+    json_classify_pick();
+
+    JsonStage1Carry carry = {0};
+    for (const char *p = *buf; p != end; ) {
+        const size_t n = end - p < 64 ? (size_t) (end - p) : 64;
+        JsonBlockMasks m;
+        json_classify_block(p, n, &m);
+        uint64_t quotes;
+        const uint64_t in_string = json_in_string(&m, &carry, &quotes);
+        uint64_t open = m.open & ~in_string;
+        uint64_t close = m.bracket & ~m.open & ~in_string;
+
+        // the depth can only reach zero in this block if it has enough closing brackets
+        if ((size_t) __builtin_popcountll(close) < level) {
+            level += __builtin_popcountll(open) - __builtin_popcountll(close);
+            p += n;
+            continue;
+        }
+        while (close) {
+            const uint64_t before = (close & -close) - 1;
+            level += __builtin_popcountll(open & before);
+            open &= ~before;
+            if (!--level) {
+                *buf = p + __builtin_ctzll(close) + 1;
+                return;
+            }
+            close &= close - 1;
+        }
+        level += __builtin_popcountll(open);
+        p += n;
+    }
+    *buf = end;
+}
+
+// Same as json_skip(), but once inside a container, finds the matching closing bracket with
+// json_skip_close() instead of going through the tokens.
+void
+json_skip_fast(const char **buf, const char *end)
+{
+    const JsonTokenType t = json_advance(buf, end, NULL);
+    if (t == JTT_MAP_START || t == JTT_LIST_START) {
+        json_skip_close(buf, end, 1);
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Streaming: the input comes in chunks, and a token can be cut by the end of one.
+//
+// Tokens that are entirely inside a chunk point into the chunk. A token that is cut off is
+// copied into 'partial' and completed from the following chunks, and then points there.
+// Either way, it stays valid until the next call to json_stream_advance().
+
+typedef enum {
+    JSP_NONE,
+    JSP_STRING,
+    JSP_NUMBER,
+    JSP_LITERAL,
+} JsonStreamPartial;
+
+typedef struct {
+    const char *cur;
+    const char *end;
+    int last; // no chunk after this one
+
+    JsonStreamPartial partial_kind;
+    int partial_done; // 'partial' holds the token returned last
+    size_t partial_need; // JSP_LITERAL: how long the token is
+    char *partial;
+    size_t partial_len;
+    size_t partial_cap;
+} JsonStream;
+
+void
+json_stream_init(JsonStream *js)
+{
+    *js = (JsonStream) {0};
+}
+
+void
+json_stream_free(JsonStream *js)
+{
+    free(js->partial);
+    json_stream_init(js);
+}
+
+// The chunk has to stay valid until json_stream_advance() returns JTT_MORE (or the token
+// after the last one). Can only be called when the previous chunk is used up.
+void
+json_stream_feed(JsonStream *js, const char *buf, const char *end, int last)
+{
+    js->cur = buf;
+    js->end = end;
+    js->last = last;
+}
+
+static int
+json_stream_keep(JsonStream *js, const char *s, size_t n)
+{
+    if (js->partial_cap - js->partial_len < n) {
+        size_t cap = js->partial_cap ? js->partial_cap : 64;
+        while (cap - js->partial_len < n) {
+            cap *= 2;
+        }
+        char *p = realloc(js->partial, cap);
+        if (!p) {
+            return 0;
+        }
+        js->partial = p;
+        js->partial_cap = cap;
+    }
+    memcpy(js->partial + js->partial_len, s, n);
+    js->partial_len += n;
+    return 1;
+}
+
+// Finds the end of the token in 'partial' in the current chunk and appends the missing
+// bytes. Returns 1 once the token is complete, 0 if the whole chunk was taken, -1 on error.
+static int
+json_stream_resume(JsonStream *js)
+{
+    static const unsigned char tableisnum[256] = {
+        ['0' ... '9'] = 1,
+        ['.'] = 1,
+        ['-'] = 1,
+        ['e'] = 1,
+        ['E'] = 1,
+        ['+'] = 1,
+    };
+
+    const char *s = js->cur, *end = js->end, *stop = end;
+    int done = 0;
+    switch (js->partial_kind) {
+        case JSP_STRING: {
+            // an odd run of backslashes at the end of 'partial' escapes the first byte
+            size_t nbs = 0;
+            while (js->partial[js->partial_len - 1 - nbs] == '\\') { ++nbs; }
+            const char *base = s + (nbs & 1 && s != end);
+            const char *q = base;
+            while (1) {
+                const size_t n = end - q;
+                if (!n || !(q = memchr(q, '"', n))) {
+                    break;
+                }
+                nbs = 0;
+                while (q - nbs != base && q[-nbs - 1] == '\\') { ++nbs; }
+                ++q;
+                if (!(nbs & 1)) {
+                    stop = q;
+                    done = 1;
+                    break;
+                }
+            }
+            break;
+        }
+
+        case JSP_NUMBER:
+            for (stop = s; stop != end && tableisnum[(unsigned char) *stop]; ++stop) {}
+            done = stop != end;
+            break;
+
+        case JSP_LITERAL:
+            if ((size_t) (end - s) >= js->partial_need - js->partial_len) {
+                stop = s + (js->partial_need - js->partial_len);
+                done = 1;
+            }
+            break;
+
+        case JSP_NONE:
+            return 1;
+    }
+
+    if (!json_stream_keep(js, s, stop - s)) {
+        return -1;
+    }
+    js->cur = stop;
+    return done;
+}
+
+// Same as json_advance() on the concatenation of the chunks, except that the token end is
+// returned too ('start' and 'stop' are only set for strings and numbers), and JTT_MORE is
+// returned when the current chunk is used up and it is not the last one.
+JsonTokenType
+json_stream_advance(JsonStream *js, const char **start, const char **stop)
+{
+    static const unsigned char tableisstart[256] = {
+        ['{'] = 1, ['}'] = 1, ['['] = 1, [']'] = 1, ['"'] = 1,
+        ['-'] = 1, ['0' ... '9'] = 1, ['t'] = 1, ['f'] = 1, ['n'] = 1,
+    };
+
+    if (js->partial_done) {
+        js->partial_done = 0;
+        js->partial_kind = JSP_NONE;
+        js->partial_len = 0;
+    }
+
+    if (js->partial_kind != JSP_NONE) {
+        const int r = json_stream_resume(js);
+        if (r < 0) {
+            return JTT_ERROR;
+        }
+        if (!r) {
+            if (!js->last) {
+                return JTT_MORE;
+            }
+            if (js->partial_kind != JSP_NUMBER) {
+                return JTT_ERROR;
+            }
+        }
+
+        // run the completed token through json_advance() for its type
+        js->partial_done = 1;
+        const char *p = js->partial, *pend = p + js->partial_len, *s = NULL;
+        const JsonTokenType t = json_advance(&p, pend, &s);
+        if (start) { *start = s; }
+        if (stop) { *stop = pend; }
+        return t;
+    }
+
+    const char *s = js->cur, *end = js->end;
+    while (s != end && !tableisstart[(unsigned char) *s]) {
+        ++s;
+    }
+    if (s == end) {
+        js->cur = end;
+        return js->last ? JTT_EOT : JTT_MORE;
+    }
+
+    const char *p = s, *tstart = NULL;
+    const JsonTokenType t = json_advance(&p, end, &tstart);
+    JsonStreamPartial kind = JSP_NONE;
+    if (t == JTT_ERROR) {
+        // only strings and literals can be cut
+        if (*s == '"') {
+            kind = JSP_STRING;
+        } else {
+            kind = JSP_LITERAL;
+            js->partial_need = *s == 'f' ? 5 : 4;
+        }
+    } else if (t == JTT_NUMBER && p == end) {
+        kind = JSP_NUMBER;
+    }
+
+    if (kind == JSP_NONE || js->last) {
+        js->cur = kind == JSP_NONE ? p : end;
+        if (start) { *start = tstart; }
+        if (stop) { *stop = p; }
+        return t;
+    }
+
+    js->partial_kind = kind;
+    js->partial_len = 0;
+    if (!json_stream_keep(js, s, end - s)) {
+        return JTT_ERROR;
+    }
+    js->cur = end;
+    return JTT_MORE;
+}
+
+//-----------------------------------------------------------------------------
+// Tape: a whole document as one flat array of 64-bit entries, the token type in the top
+// 8 bits and a payload in the rest.
+//
+//   JTT_MAP_START, JTT_LIST_START  index just past the matching end entry
+//   JTT_MAP_END, JTT_LIST_END      index of the matching start entry
+//   JTT_STRING, JTT_NUMBER         offset of the contents (without the quotes) from the
+//                                  document start; the next entry is the length
+//   JTT_TRUE, JTT_FALSE, JTT_NULL  0
+//
+// A token takes at least one byte, and only strings and numbers take two entries: a string
+// is at least 2 bytes, and a number is at least 1 byte followed by something else. So a
+// document of n bytes never needs more than 3n/2 + 2 entries, which is allocated up front
+// (from the size of '[*buf, end)', so pass the document, e.g. a line of NDJSON, and not a
+// whole file of them). The allocation is kept from one document to the next.
+
+#define JSON_TAPE_PAYLOAD ((UINT64_C(1) << 56) - 1)
+
+typedef struct {
+    uint64_t *v;
+    size_t len;
+    size_t cap;
+    const char *base; // the document the offsets are relative to
+} JsonTape;
+
+void
+json_tape_init(JsonTape *t)
+{
+    *t = (JsonTape) {0};
+}
+
+void
+json_tape_free(JsonTape *t)
+{
+    free(t->v);
+    json_tape_init(t);
+}
+
+static inline JsonTokenType
+json_tape_type(const JsonTape *t, size_t i)
+{
+    return (JsonTokenType) (t->v[i] >> 56);
+}
+
+static inline uint64_t
+json_tape_payload(const JsonTape *t, size_t i)
+{
+    return t->v[i] & JSON_TAPE_PAYLOAD;
+}
+
+// Index of the entry after the value at 'i', skipping containers in O(1).
+static inline size_t
+json_tape_next(const JsonTape *t, size_t i)
+{
+    switch (json_tape_type(t, i)) {
+        case JTT_MAP_START:
+        case JTT_LIST_START:
+            return json_tape_payload(t, i);
+        case JTT_STRING:
+        case JTT_NUMBER:
+            return i + 2;
+        default:
+            return i + 1;
+    }
+}
+
+// Contents of the string or number at 'i'.
+static inline const char *
+json_tape_str(const JsonTape *t, size_t i, size_t *len)
+{
+    *len = t->v[i + 1];
+    return t->base + json_tape_payload(t, i);
+}
+
+// Parses one value from '*buf' into the tape, which is reset first, and moves '*buf' past
+// it. Returns the type of the value, JTT_EOT if there is none left, or JTT_ERROR if it is
+// not well-formed (brackets that do not match, map keys that are not strings, a key without
+// a value) or the tape cannot be allocated.
+JsonTokenType
+json_tape_parse(JsonTape *t, const char **buf, const char *end)
+{
+    const size_t n = end - *buf;
+    if (t->cap < n + n / 2 + 2) {
+        free(t->v);
+        t->cap = n + n / 2 + 2;
+        if (!(t->v = malloc(t->cap * sizeof(*t->v)))) {
+            t->cap = 0;
+            return JTT_ERROR;
+        }
+    }
+    t->len = 0;
+    t->base = *buf;
+
+#define EMIT(Type_, Payload_) t->v[t->len++] = (uint64_t) (Type_) << 56 | (Payload_)
+
+    // While a container is open, its start entry holds the index of the enclosing one
+    // (or JSON_TAPE_PAYLOAD at the root) instead of its end.
+    size_t open = JSON_TAPE_PAYLOAD;
+    int expect_key = 0;
+    const char *s = *buf;
+    do {
+        const char *start;
+        const JsonTokenType tt = json_advance(&s, end, &start);
+        if (expect_key && tt != JTT_STRING && tt != JTT_MAP_END) {
+            return JTT_ERROR;
+        }
+
+        switch (tt) {
+            case JTT_MAP_START:
+            case JTT_LIST_START:
+                EMIT(tt, open);
+                open = t->len - 1;
+                expect_key = tt == JTT_MAP_START;
+                break;
+
+            case JTT_MAP_END:
+            case JTT_LIST_END: {
+                if (open == JSON_TAPE_PAYLOAD
+                    || json_tape_type(t, open) != tt - 1
+                    || (tt == JTT_MAP_END && !expect_key))
+                {
+                    return JTT_ERROR;
+                }
+                const size_t parent = json_tape_payload(t, open);
+                EMIT(tt, open);
+                t->v[open] = (uint64_t) (tt - 1) << 56 | t->len;
+                open = parent;
+                expect_key = open != JSON_TAPE_PAYLOAD && json_tape_type(t, open) == JTT_MAP_START;
+                break;
+            }
+
+            case JTT_STRING:
+            case JTT_NUMBER: {
+                const int q = tt == JTT_STRING;
+                EMIT(tt, start + q - *buf);
+                t->v[t->len++] = s - start - 2 * q;
+                if (open != JSON_TAPE_PAYLOAD && json_tape_type(t, open) == JTT_MAP_START) {
+                    expect_key = !expect_key;
+                }
+                break;
+            }
+
+            case JTT_TRUE:
+            case JTT_FALSE:
+            case JTT_NULL:
+                EMIT(tt, 0);
+                expect_key = open != JSON_TAPE_PAYLOAD && json_tape_type(t, open) == JTT_MAP_START;
+                break;
+
+            case JTT_EOT:
+                if (open == JSON_TAPE_PAYLOAD) {
+                    *buf = s;
+                    return JTT_EOT;
+                }
+                return JTT_ERROR;
+
+            default:
+                return JTT_ERROR;
+        }
+    } while (open != JSON_TAPE_PAYLOAD);
+#undef EMIT
+
+    *buf = s;
+    return json_tape_type(t, 0);
+}
+
+//-----------------------------------------------------------------------------
+// Numbers: strict JSON grammar -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)? and conversion
+// to int64_t or double, from a [s, end) span such as the one JTT_NUMBER gives.
+//
+// Doubles take Clinger's exact path when the digits and the power of ten both fit in a
+// double, then Eisel-Lemire: the digits times a 128-bit approximation of 5^q, which gives the
+// correctly rounded result unless the product is too close to call. More than 19 significant
+// digits, or a product too close to call, goes to strtod() on a copy (which assumes the C
+// locale's decimal point).
+
+static inline uint64_t
+json_load8(const char *s)
+{
+    uint64_t v;
+    memcpy(&v, s, 8);
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    v = __builtin_bswap64(v);
+#endif
+    return v;
+}
+
+static inline int
+json_is_8digits(uint64_t v)
+{
+    return !(((v + 0x4646464646464646ull) | (v - 0x3030303030303030ull)) & 0x8080808080808080ull);
+}
+
+// The value of 8 ASCII digits, first digit in the low byte.
+static inline uint64_t
+json_parse_8digits(uint64_t v)
+{
+    v -= 0x3030303030303030ull;
+    v = v * 10 + (v >> 8); // pairs of digits in bytes 0, 2, 4, 6
+    return ((v & 0x000000ff000000ffull) * (100 + (1000000ull << 32))
+            + ((v >> 16) & 0x000000ff000000ffull) * (1 + (10000ull << 32))) >> 32;
+}
+
+// Returns the end of the digits at 's', adding them to '*w'.
+static inline const char *
+json_scan_digits(const char *s, const char *end, uint64_t *w)
+{
+    while (end - s >= 8 && json_is_8digits(json_load8(s))) {
+        *w = *w * 100000000 + json_parse_8digits(json_load8(s));
+        s += 8;
+    }
+    while (s != end && (unsigned char) (*s - '0') < 10) {
+        *w = *w * 10 + (*s - '0');
+        ++s;
+    }
+    return s;
+}
+
+typedef struct {
+    uint64_t w;  // the number is (-1)^neg * w * 10^q
+    int64_t q;
+    int neg;
+    int exact;   // 0 if 'w' overflowed (more than 19 significant digits)
+    int integer; // no fraction and no exponent
+} JsonNumber;
+
+static int
+json_number_scan(const char *s, const char *end, JsonNumber *n)
+{
+    *n = (JsonNumber) {.exact = 1, .integer = 1};
+    n->neg = s != end && *s == '-';
+    s += n->neg;
+
+    const char *digits = s;
+    if (s == end) {
+        return 0;
+    } else if (*s == '0') {
+        ++s;
+    } else if ((unsigned char) (*s - '1') < 9) {
+        s = json_scan_digits(s, end, &n->w);
+    } else {
+        return 0;
+    }
+    size_t ndigits = s - digits;
+
+    if (s != end && *s == '.') {
+        const char *frac = ++s;
+        s = json_scan_digits(s, end, &n->w);
+        if (s == frac) {
+            return 0;
+        }
+        n->q = -(s - frac);
+        ndigits += s - frac;
+        n->integer = 0;
+    }
+
+    if (s != end && (*s | 0x20) == 'e') {
+        ++s;
+        const int eneg = s != end && *s == '-';
+        s += s != end && (*s == '-' || *s == '+');
+        const char *exp = s;
+        int64_t e = 0;
+        for (; s != end && (unsigned char) (*s - '0') < 10; ++s) {
+            if (e < 100000) {
+                e = e * 10 + (*s - '0');
+            }
+        }
+        if (s == exp) {
+            return 0;
+        }
+        n->q += eneg ? -e : e;
+        n->integer = 0;
+    }
+
+    if (s != end) {
+        return 0;
+    }
+    if (ndigits > 19) {
+        // leading zeros (of 0.000ddd) do not count
+        for (const char *p = digits; p != end && (*p == '0' || *p == '.'); ++p) {
+            ndigits -= *p == '0';
+        }
+        n->exact = ndigits <= 19;
+    }
+    return 1;
+}
+
+// Converts an integer; fails if it has a fraction or an exponent or does not fit.
+int
+json_number_int64(const char *s, const char *end, int64_t *out)
+{
+    JsonNumber n;
+    if (!json_number_scan(s, end, &n) || !n.integer || !n.exact) {
+        return 0;
+    }
+    if (n.w > (uint64_t) INT64_MAX + n.neg) {
+        return 0;
+    }
+    *out = n.neg ? (int64_t) (0 - n.w) : (int64_t) n.w;
+    return 1;
+}
+
+// 128-bit truncations of 5^q for q in [-342, 324], high word first, normalized so that the
+// top bit is set (so they are also the significands of 10^q). Generated with:
+//
+//   for q in range(-342, 0):
+//       p = 5**-q; z = p.bit_length()
+//       c = 2**(z + 127) // p + 1 if q >= -27 else 2**(2*z + 128) // p + 1
+//       while c >= 1 << 128: c //= 2
+//   for q in range(0, 325):
+//       p = 5**q
+//       while p < 1 << 127: p *= 2
+//       while p >= 1 << 128: p //= 2
+static const uint64_t json_pow5_128[667][2] = {
+    {0xeef453d6923bd65aull, 0x113faa2906a13b3full}, {0x9558b4661b6565f8ull, 0x4ac7ca59a424c507ull},
+    {0xbaaee17fa23ebf76ull, 0x5d79bcf00d2df649ull}, {0xe95a99df8ace6f53ull, 0xf4d82c2c107973dcull},
+    {0x91d8a02bb6c10594ull, 0x79071b9b8a4be869ull}, {0xb64ec836a47146f9ull, 0x9748e2826cdee284ull},
+    {0xe3e27a444d8d98b7ull, 0xfd1b1b2308169b25ull}, {0x8e6d8c6ab0787f72ull, 0xfe30f0f5e50e20f7ull},
+    {0xb208ef855c969f4full, 0xbdbd2d335e51a935ull}, {0xde8b2b66b3bc4723ull, 0xad2c788035e61382ull},
+    {0x8b16fb203055ac76ull, 0x4c3bcb5021afcc31ull}, {0xaddcb9e83c6b1793ull, 0xdf4abe242a1bbf3dull},
+    {0xd953e8624b85dd78ull, 0xd71d6dad34a2af0dull}, {0x87d4713d6f33aa6bull, 0x8672648c40e5ad68ull},
+    {0xa9c98d8ccb009506ull, 0x680efdaf511f18c2ull}, {0xd43bf0effdc0ba48ull, 0x0212bd1b2566def2ull},
+    {0x84a57695fe98746dull, 0x014bb630f7604b57ull}, {0xa5ced43b7e3e9188ull, 0x419ea3bd35385e2dull},
+    {0xcf42894a5dce35eaull, 0x52064cac828675b9ull}, {0x818995ce7aa0e1b2ull, 0x7343efebd1940993ull},
+    {0xa1ebfb4219491a1full, 0x1014ebe6c5f90bf8ull}, {0xca66fa129f9b60a6ull, 0xd41a26e077774ef6ull},
+    {0xfd00b897478238d0ull, 0x8920b098955522b4ull}, {0x9e20735e8cb16382ull, 0x55b46e5f5d5535b0ull},
+    {0xc5a890362fddbc62ull, 0xeb2189f734aa831dull}, {0xf712b443bbd52b7bull, 0xa5e9ec7501d523e4ull},
+    {0x9a6bb0aa55653b2dull, 0x47b233c92125366eull}, {0xc1069cd4eabe89f8ull, 0x999ec0bb696e840aull},
+    {0xf148440a256e2c76ull, 0xc00670ea43ca250dull}, {0x96cd2a865764dbcaull, 0x380406926a5e5728ull},
+    {0xbc807527ed3e12bcull, 0xc605083704f5ecf2ull}, {0xeba09271e88d976bull, 0xf7864a44c633682eull},
+    {0x93445b8731587ea3ull, 0x7ab3ee6afbe0211dull}, {0xb8157268fdae9e4cull, 0x5960ea05bad82964ull},
+    {0xe61acf033d1a45dfull, 0x6fb92487298e33bdull}, {0x8fd0c16206306babull, 0xa5d3b6d479f8e056ull},
+    {0xb3c4f1ba87bc8696ull, 0x8f48a4899877186cull}, {0xe0b62e2929aba83cull, 0x331acdabfe94de87ull},
+    {0x8c71dcd9ba0b4925ull, 0x9ff0c08b7f1d0b14ull}, {0xaf8e5410288e1b6full, 0x07ecf0ae5ee44dd9ull},
+    {0xdb71e91432b1a24aull, 0xc9e82cd9f69d6150ull}, {0x892731ac9faf056eull, 0xbe311c083a225cd2ull},
+    {0xab70fe17c79ac6caull, 0x6dbd630a48aaf406ull}, {0xd64d3d9db981787dull, 0x092cbbccdad5b108ull},
+    {0x85f0468293f0eb4eull, 0x25bbf56008c58ea5ull}, {0xa76c582338ed2621ull, 0xaf2af2b80af6f24eull},
+    {0xd1476e2c07286faaull, 0x1af5af660db4aee1ull}, {0x82cca4db847945caull, 0x50d98d9fc890ed4dull},
+    {0xa37fce126597973cull, 0xe50ff107bab528a0ull}, {0xcc5fc196fefd7d0cull, 0x1e53ed49a96272c8ull},
+    {0xff77b1fcbebcdc4full, 0x25e8e89c13bb0f7aull}, {0x9faacf3df73609b1ull, 0x77b191618c54e9acull},
+    {0xc795830d75038c1dull, 0xd59df5b9ef6a2417ull}, {0xf97ae3d0d2446f25ull, 0x4b0573286b44ad1dull},
+    {0x9becce62836ac577ull, 0x4ee367f9430aec32ull}, {0xc2e801fb244576d5ull, 0x229c41f793cda73full},
+    {0xf3a20279ed56d48aull, 0x6b43527578c1110full}, {0x9845418c345644d6ull, 0x830a13896b78aaa9ull},
+    {0xbe5691ef416bd60cull, 0x23cc986bc656d553ull}, {0xedec366b11c6cb8full, 0x2cbfbe86b7ec8aa8ull},
+    {0x94b3a202eb1c3f39ull, 0x7bf7d71432f3d6a9ull}, {0xb9e08a83a5e34f07ull, 0xdaf5ccd93fb0cc53ull},
+    {0xe858ad248f5c22c9ull, 0xd1b3400f8f9cff68ull}, {0x91376c36d99995beull, 0x23100809b9c21fa1ull},
+    {0xb58547448ffffb2dull, 0xabd40a0c2832a78aull}, {0xe2e69915b3fff9f9ull, 0x16c90c8f323f516cull},
+    {0x8dd01fad907ffc3bull, 0xae3da7d97f6792e3ull}, {0xb1442798f49ffb4aull, 0x99cd11cfdf41779cull},
+    {0xdd95317f31c7fa1dull, 0x40405643d711d583ull}, {0x8a7d3eef7f1cfc52ull, 0x482835ea666b2572ull},
+    {0xad1c8eab5ee43b66ull, 0xda3243650005eecfull}, {0xd863b256369d4a40ull, 0x90bed43e40076a82ull},
+    {0x873e4f75e2224e68ull, 0x5a7744a6e804a291ull}, {0xa90de3535aaae202ull, 0x711515d0a205cb36ull},
+    {0xd3515c2831559a83ull, 0x0d5a5b44ca873e03ull}, {0x8412d9991ed58091ull, 0xe858790afe9486c2ull},
+    {0xa5178fff668ae0b6ull, 0x626e974dbe39a872ull}, {0xce5d73ff402d98e3ull, 0xfb0a3d212dc8128full},
+    {0x80fa687f881c7f8eull, 0x7ce66634bc9d0b99ull}, {0xa139029f6a239f72ull, 0x1c1fffc1ebc44e80ull},
+    {0xc987434744ac874eull, 0xa327ffb266b56220ull}, {0xfbe9141915d7a922ull, 0x4bf1ff9f0062baa8ull},
+    {0x9d71ac8fada6c9b5ull, 0x6f773fc3603db4a9ull}, {0xc4ce17b399107c22ull, 0xcb550fb4384d21d3ull},
+    {0xf6019da07f549b2bull, 0x7e2a53a146606a48ull}, {0x99c102844f94e0fbull, 0x2eda7444cbfc426dull},
+    {0xc0314325637a1939ull, 0xfa911155fefb5308ull}, {0xf03d93eebc589f88ull, 0x793555ab7eba27caull},
+    {0x96267c7535b763b5ull, 0x4bc1558b2f3458deull}, {0xbbb01b9283253ca2ull, 0x9eb1aaedfb016f16ull},
+    {0xea9c227723ee8bcbull, 0x465e15a979c1cadcull}, {0x92a1958a7675175full, 0x0bfacd89ec191ec9ull},
+    {0xb749faed14125d36ull, 0xcef980ec671f667bull}, {0xe51c79a85916f484ull, 0x82b7e12780e7401aull},
+    {0x8f31cc0937ae58d2ull, 0xd1b2ecb8b0908810ull}, {0xb2fe3f0b8599ef07ull, 0x861fa7e6dcb4aa15ull},
+    {0xdfbdcece67006ac9ull, 0x67a791e093e1d49aull}, {0x8bd6a141006042bdull, 0xe0c8bb2c5c6d24e0ull},
+    {0xaecc49914078536dull, 0x58fae9f773886e18ull}, {0xda7f5bf590966848ull, 0xaf39a475506a899eull},
+    {0x888f99797a5e012dull, 0x6d8406c952429603ull}, {0xaab37fd7d8f58178ull, 0xc8e5087ba6d33b83ull},
+    {0xd5605fcdcf32e1d6ull, 0xfb1e4a9a90880a64ull}, {0x855c3be0a17fcd26ull, 0x5cf2eea09a55067full},
+    {0xa6b34ad8c9dfc06full, 0xf42faa48c0ea481eull}, {0xd0601d8efc57b08bull, 0xf13b94daf124da26ull},
+    {0x823c12795db6ce57ull, 0x76c53d08d6b70858ull}, {0xa2cb1717b52481edull, 0x54768c4b0c64ca6eull},
+    {0xcb7ddcdda26da268ull, 0xa9942f5dcf7dfd09ull}, {0xfe5d54150b090b02ull, 0xd3f93b35435d7c4cull},
+    {0x9efa548d26e5a6e1ull, 0xc47bc5014a1a6dafull}, {0xc6b8e9b0709f109aull, 0x359ab6419ca1091bull},
+    {0xf867241c8cc6d4c0ull, 0xc30163d203c94b62ull}, {0x9b407691d7fc44f8ull, 0x79e0de63425dcf1dull},
+    {0xc21094364dfb5636ull, 0x985915fc12f542e4ull}, {0xf294b943e17a2bc4ull, 0x3e6f5b7b17b2939dull},
+    {0x979cf3ca6cec5b5aull, 0xa705992ceecf9c42ull}, {0xbd8430bd08277231ull, 0x50c6ff782a838353ull},
+    {0xece53cec4a314ebdull, 0xa4f8bf5635246428ull}, {0x940f4613ae5ed136ull, 0x871b7795e136be99ull},
+    {0xb913179899f68584ull, 0x28e2557b59846e3full}, {0xe757dd7ec07426e5ull, 0x331aeada2fe589cfull},
+    {0x9096ea6f3848984full, 0x3ff0d2c85def7621ull}, {0xb4bca50b065abe63ull, 0x0fed077a756b53a9ull},
+    {0xe1ebce4dc7f16dfbull, 0xd3e8495912c62894ull}, {0x8d3360f09cf6e4bdull, 0x64712dd7abbbd95cull},
+    {0xb080392cc4349decull, 0xbd8d794d96aacfb3ull}, {0xdca04777f541c567ull, 0xecf0d7a0fc5583a0ull},
+    {0x89e42caaf9491b60ull, 0xf41686c49db57244ull}, {0xac5d37d5b79b6239ull, 0x311c2875c522ced5ull},
+    {0xd77485cb25823ac7ull, 0x7d633293366b828bull}, {0x86a8d39ef77164bcull, 0xae5dff9c02033197ull},
+    {0xa8530886b54dbdebull, 0xd9f57f830283fdfcull}, {0xd267caa862a12d66ull, 0xd072df63c324fd7bull},
+    {0x8380dea93da4bc60ull, 0x4247cb9e59f71e6dull}, {0xa46116538d0deb78ull, 0x52d9be85f074e608ull},
+    {0xcd795be870516656ull, 0x67902e276c921f8bull}, {0x806bd9714632dff6ull, 0x00ba1cd8a3db53b6ull},
+    {0xa086cfcd97bf97f3ull, 0x80e8a40eccd228a4ull}, {0xc8a883c0fdaf7df0ull, 0x6122cd128006b2cdull},
+    {0xfad2a4b13d1b5d6cull, 0x796b805720085f81ull}, {0x9cc3a6eec6311a63ull, 0xcbe3303674053bb0ull},
+    {0xc3f490aa77bd60fcull, 0xbedbfc4411068a9cull}, {0xf4f1b4d515acb93bull, 0xee92fb5515482d44ull},
+    {0x991711052d8bf3c5ull, 0x751bdd152d4d1c4aull}, {0xbf5cd54678eef0b6ull, 0xd262d45a78a0635dull},
+    {0xef340a98172aace4ull, 0x86fb897116c87c34ull}, {0x9580869f0e7aac0eull, 0xd45d35e6ae3d4da0ull},
+    {0xbae0a846d2195712ull, 0x8974836059cca109ull}, {0xe998d258869facd7ull, 0x2bd1a438703fc94bull},
+    {0x91ff83775423cc06ull, 0x7b6306a34627ddcfull}, {0xb67f6455292cbf08ull, 0x1a3bc84c17b1d542ull},
+    {0xe41f3d6a7377eecaull, 0x20caba5f1d9e4a93ull}, {0x8e938662882af53eull, 0x547eb47b7282ee9cull},
+    {0xb23867fb2a35b28dull, 0xe99e619a4f23aa43ull}, {0xdec681f9f4c31f31ull, 0x6405fa00e2ec94d4ull},
+    {0x8b3c113c38f9f37eull, 0xde83bc408dd3dd04ull}, {0xae0b158b4738705eull, 0x9624ab50b148d445ull},
+    {0xd98ddaee19068c76ull, 0x3badd624dd9b0957ull}, {0x87f8a8d4cfa417c9ull, 0xe54ca5d70a80e5d6ull},
+    {0xa9f6d30a038d1dbcull, 0x5e9fcf4ccd211f4cull}, {0xd47487cc8470652bull, 0x7647c3200069671full},
+    {0x84c8d4dfd2c63f3bull, 0x29ecd9f40041e073ull}, {0xa5fb0a17c777cf09ull, 0xf468107100525890ull},
+    {0xcf79cc9db955c2ccull, 0x7182148d4066eeb4ull}, {0x81ac1fe293d599bfull, 0xc6f14cd848405530ull},
+    {0xa21727db38cb002full, 0xb8ada00e5a506a7cull}, {0xca9cf1d206fdc03bull, 0xa6d90811f0e4851cull},
+    {0xfd442e4688bd304aull, 0x908f4a166d1da663ull}, {0x9e4a9cec15763e2eull, 0x9a598e4e043287feull},
+    {0xc5dd44271ad3cdbaull, 0x40eff1e1853f29fdull}, {0xf7549530e188c128ull, 0xd12bee59e68ef47cull},
+    {0x9a94dd3e8cf578b9ull, 0x82bb74f8301958ceull}, {0xc13a148e3032d6e7ull, 0xe36a52363c1faf01ull},
+    {0xf18899b1bc3f8ca1ull, 0xdc44e6c3cb279ac1ull}, {0x96f5600f15a7b7e5ull, 0x29ab103a5ef8c0b9ull},
+    {0xbcb2b812db11a5deull, 0x7415d448f6b6f0e7ull}, {0xebdf661791d60f56ull, 0x111b495b3464ad21ull},
+    {0x936b9fcebb25c995ull, 0xcab10dd900beec34ull}, {0xb84687c269ef3bfbull, 0x3d5d514f40eea742ull},
+    {0xe65829b3046b0afaull, 0x0cb4a5a3112a5112ull}, {0x8ff71a0fe2c2e6dcull, 0x47f0e785eaba72abull},
+    {0xb3f4e093db73a093ull, 0x59ed216765690f56ull}, {0xe0f218b8d25088b8ull, 0x306869c13ec3532cull},
+    {0x8c974f7383725573ull, 0x1e414218c73a13fbull}, {0xafbd2350644eeacfull, 0xe5d1929ef90898faull},
+    {0xdbac6c247d62a583ull, 0xdf45f746b74abf39ull}, {0x894bc396ce5da772ull, 0x6b8bba8c328eb783ull},
+    {0xab9eb47c81f5114full, 0x066ea92f3f326564ull}, {0xd686619ba27255a2ull, 0xc80a537b0efefebdull},
+    {0x8613fd0145877585ull, 0xbd06742ce95f5f36ull}, {0xa798fc4196e952e7ull, 0x2c48113823b73704ull},
+    {0xd17f3b51fca3a7a0ull, 0xf75a15862ca504c5ull}, {0x82ef85133de648c4ull, 0x9a984d73dbe722fbull},
+    {0xa3ab66580d5fdaf5ull, 0xc13e60d0d2e0ebbaull}, {0xcc963fee10b7d1b3ull, 0x318df905079926a8ull},
+    {0xffbbcfe994e5c61full, 0xfdf17746497f7052ull}, {0x9fd561f1fd0f9bd3ull, 0xfeb6ea8bedefa633ull},
+    {0xc7caba6e7c5382c8ull, 0xfe64a52ee96b8fc0ull}, {0xf9bd690a1b68637bull, 0x3dfdce7aa3c673b0ull},
+    {0x9c1661a651213e2dull, 0x06bea10ca65c084eull}, {0xc31bfa0fe5698db8ull, 0x486e494fcff30a62ull},
+    {0xf3e2f893dec3f126ull, 0x5a89dba3c3efccfaull}, {0x986ddb5c6b3a76b7ull, 0xf89629465a75e01cull},
+    {0xbe89523386091465ull, 0xf6bbb397f1135823ull}, {0xee2ba6c0678b597full, 0x746aa07ded582e2cull},
+    {0x94db483840b717efull, 0xa8c2a44eb4571cdcull}, {0xba121a4650e4ddebull, 0x92f34d62616ce413ull},
+    {0xe896a0d7e51e1566ull, 0x77b020baf9c81d17ull}, {0x915e2486ef32cd60ull, 0x0ace1474dc1d122eull},
+    {0xb5b5ada8aaff80b8ull, 0x0d819992132456baull}, {0xe3231912d5bf60e6ull, 0x10e1fff697ed6c69ull},
+    {0x8df5efabc5979c8full, 0xca8d3ffa1ef463c1ull}, {0xb1736b96b6fd83b3ull, 0xbd308ff8a6b17cb2ull},
+    {0xddd0467c64bce4a0ull, 0xac7cb3f6d05ddbdeull}, {0x8aa22c0dbef60ee4ull, 0x6bcdf07a423aa96bull},
+    {0xad4ab7112eb3929dull, 0x86c16c98d2c953c6ull}, {0xd89d64d57a607744ull, 0xe871c7bf077ba8b7ull},
+    {0x87625f056c7c4a8bull, 0x11471cd764ad4972ull}, {0xa93af6c6c79b5d2dull, 0xd598e40d3dd89bcfull},
+    {0xd389b47879823479ull, 0x4aff1d108d4ec2c3ull}, {0x843610cb4bf160cbull, 0xcedf722a585139baull},
+    {0xa54394fe1eedb8feull, 0xc2974eb4ee658828ull}, {0xce947a3da6a9273eull, 0x733d226229feea32ull},
+    {0x811ccc668829b887ull, 0x0806357d5a3f525full}, {0xa163ff802a3426a8ull, 0xca07c2dcb0cf26f7ull},
+    {0xc9bcff6034c13052ull, 0xfc89b393dd02f0b5ull}, {0xfc2c3f3841f17c67ull, 0xbbac2078d443ace2ull},
+    {0x9d9ba7832936edc0ull, 0xd54b944b84aa4c0dull}, {0xc5029163f384a931ull, 0x0a9e795e65d4df11ull},
+    {0xf64335bcf065d37dull, 0x4d4617b5ff4a16d5ull}, {0x99ea0196163fa42eull, 0x504bced1bf8e4e45ull},
+    {0xc06481fb9bcf8d39ull, 0xe45ec2862f71e1d6ull}, {0xf07da27a82c37088ull, 0x5d767327bb4e5a4cull},
+    {0x964e858c91ba2655ull, 0x3a6a07f8d510f86full}, {0xbbe226efb628afeaull, 0x890489f70a55368bull},
+    {0xeadab0aba3b2dbe5ull, 0x2b45ac74ccea842eull}, {0x92c8ae6b464fc96full, 0x3b0b8bc90012929dull},
+    {0xb77ada0617e3bbcbull, 0x09ce6ebb40173744ull}, {0xe55990879ddcaabdull, 0xcc420a6a101d0515ull},
+    {0x8f57fa54c2a9eab6ull, 0x9fa946824a12232dull}, {0xb32df8e9f3546564ull, 0x47939822dc96abf9ull},
+    {0xdff9772470297ebdull, 0x59787e2b93bc56f7ull}, {0x8bfbea76c619ef36ull, 0x57eb4edb3c55b65aull},
+    {0xaefae51477a06b03ull, 0xede622920b6b23f1ull}, {0xdab99e59958885c4ull, 0xe95fab368e45ecedull},
+    {0x88b402f7fd75539bull, 0x11dbcb0218ebb414ull}, {0xaae103b5fcd2a881ull, 0xd652bdc29f26a119ull},
+    {0xd59944a37c0752a2ull, 0x4be76d3346f0495full}, {0x857fcae62d8493a5ull, 0x6f70a4400c562ddbull},
+    {0xa6dfbd9fb8e5b88eull, 0xcb4ccd500f6bb952ull}, {0xd097ad07a71f26b2ull, 0x7e2000a41346a7a7ull},
+    {0x825ecc24c873782full, 0x8ed400668c0c28c8ull}, {0xa2f67f2dfa90563bull, 0x728900802f0f32faull},
+    {0xcbb41ef979346bcaull, 0x4f2b40a03ad2ffb9ull}, {0xfea126b7d78186bcull, 0xe2f610c84987bfa8ull},
+    {0x9f24b832e6b0f436ull, 0x0dd9ca7d2df4d7c9ull}, {0xc6ede63fa05d3143ull, 0x91503d1c79720dbbull},
+    {0xf8a95fcf88747d94ull, 0x75a44c6397ce912aull}, {0x9b69dbe1b548ce7cull, 0xc986afbe3ee11abaull},
+    {0xc24452da229b021bull, 0xfbe85badce996168ull}, {0xf2d56790ab41c2a2ull, 0xfae27299423fb9c3ull},
+    {0x97c560ba6b0919a5ull, 0xdccd879fc967d41aull}, {0xbdb6b8e905cb600full, 0x5400e987bbc1c920ull},
+    {0xed246723473e3813ull, 0x290123e9aab23b68ull}, {0x9436c0760c86e30bull, 0xf9a0b6720aaf6521ull},
+    {0xb94470938fa89bceull, 0xf808e40e8d5b3e69ull}, {0xe7958cb87392c2c2ull, 0xb60b1d1230b20e04ull},
+    {0x90bd77f3483bb9b9ull, 0xb1c6f22b5e6f48c2ull}, {0xb4ecd5f01a4aa828ull, 0x1e38aeb6360b1af3ull},
+    {0xe2280b6c20dd5232ull, 0x25c6da63c38de1b0ull}, {0x8d590723948a535full, 0x579c487e5a38ad0eull},
+    {0xb0af48ec79ace837ull, 0x2d835a9df0c6d851ull}, {0xdcdb1b2798182244ull, 0xf8e431456cf88e65ull},
+    {0x8a08f0f8bf0f156bull, 0x1b8e9ecb641b58ffull}, {0xac8b2d36eed2dac5ull, 0xe272467e3d222f3full},
+    {0xd7adf884aa879177ull, 0x5b0ed81dcc6abb0full}, {0x86ccbb52ea94baeaull, 0x98e947129fc2b4e9ull},
+    {0xa87fea27a539e9a5ull, 0x3f2398d747b36224ull}, {0xd29fe4b18e88640eull, 0x8eec7f0d19a03aadull},
+    {0x83a3eeeef9153e89ull, 0x1953cf68300424acull}, {0xa48ceaaab75a8e2bull, 0x5fa8c3423c052dd7ull},
+    {0xcdb02555653131b6ull, 0x3792f412cb06794dull}, {0x808e17555f3ebf11ull, 0xe2bbd88bbee40bd0ull},
+    {0xa0b19d2ab70e6ed6ull, 0x5b6aceaeae9d0ec4ull}, {0xc8de047564d20a8bull, 0xf245825a5a445275ull},
+    {0xfb158592be068d2eull, 0xeed6e2f0f0d56712ull}, {0x9ced737bb6c4183dull, 0x55464dd69685606bull},
+    {0xc428d05aa4751e4cull, 0xaa97e14c3c26b886ull}, {0xf53304714d9265dfull, 0xd53dd99f4b3066a8ull},
+    {0x993fe2c6d07b7fabull, 0xe546a8038efe4029ull}, {0xbf8fdb78849a5f96ull, 0xde98520472bdd033ull},
+    {0xef73d256a5c0f77cull, 0x963e66858f6d4440ull}, {0x95a8637627989aadull, 0xdde7001379a44aa8ull},
+    {0xbb127c53b17ec159ull, 0x5560c018580d5d52ull}, {0xe9d71b689dde71afull, 0xaab8f01e6e10b4a6ull},
+    {0x9226712162ab070dull, 0xcab3961304ca70e8ull}, {0xb6b00d69bb55c8d1ull, 0x3d607b97c5fd0d22ull},
+    {0xe45c10c42a2b3b05ull, 0x8cb89a7db77c506aull}, {0x8eb98a7a9a5b04e3ull, 0x77f3608e92adb242ull},
+    {0xb267ed1940f1c61cull, 0x55f038b237591ed3ull}, {0xdf01e85f912e37a3ull, 0x6b6c46dec52f6688ull},
+    {0x8b61313bbabce2c6ull, 0x2323ac4b3b3da015ull}, {0xae397d8aa96c1b77ull, 0xabec975e0a0d081aull},
+    {0xd9c7dced53c72255ull, 0x96e7bd358c904a21ull}, {0x881cea14545c7575ull, 0x7e50d64177da2e54ull},
+    {0xaa242499697392d2ull, 0xdde50bd1d5d0b9e9ull}, {0xd4ad2dbfc3d07787ull, 0x955e4ec64b44e864ull},
+    {0x84ec3c97da624ab4ull, 0xbd5af13bef0b113eull}, {0xa6274bbdd0fadd61ull, 0xecb1ad8aeacdd58eull},
+    {0xcfb11ead453994baull, 0x67de18eda5814af2ull}, {0x81ceb32c4b43fcf4ull, 0x80eacf948770ced7ull},
+    {0xa2425ff75e14fc31ull, 0xa1258379a94d028dull}, {0xcad2f7f5359a3b3eull, 0x096ee45813a04330ull},
+    {0xfd87b5f28300ca0dull, 0x8bca9d6e188853fcull}, {0x9e74d1b791e07e48ull, 0x775ea264cf55347eull},
+    {0xc612062576589ddaull, 0x95364afe032a819eull}, {0xf79687aed3eec551ull, 0x3a83ddbd83f52205ull},
+    {0x9abe14cd44753b52ull, 0xc4926a9672793543ull}, {0xc16d9a0095928a27ull, 0x75b7053c0f178294ull},
+    {0xf1c90080baf72cb1ull, 0x5324c68b12dd6339ull}, {0x971da05074da7beeull, 0xd3f6fc16ebca5e04ull},
+    {0xbce5086492111aeaull, 0x88f4bb1ca6bcf585ull}, {0xec1e4a7db69561a5ull, 0x2b31e9e3d06c32e6ull},
+    {0x9392ee8e921d5d07ull, 0x3aff322e62439fd0ull}, {0xb877aa3236a4b449ull, 0x09befeb9fad487c3ull},
+    {0xe69594bec44de15bull, 0x4c2ebe687989a9b4ull}, {0x901d7cf73ab0acd9ull, 0x0f9d37014bf60a11ull},
+    {0xb424dc35095cd80full, 0x538484c19ef38c95ull}, {0xe12e13424bb40e13ull, 0x2865a5f206b06fbaull},
+    {0x8cbccc096f5088cbull, 0xf93f87b7442e45d4ull}, {0xafebff0bcb24aafeull, 0xf78f69a51539d749ull},
+    {0xdbe6fecebdedd5beull, 0xb573440e5a884d1cull}, {0x89705f4136b4a597ull, 0x31680a88f8953031ull},
+    {0xabcc77118461cefcull, 0xfdc20d2b36ba7c3eull}, {0xd6bf94d5e57a42bcull, 0x3d32907604691b4dull},
+    {0x8637bd05af6c69b5ull, 0xa63f9a49c2c1b110ull}, {0xa7c5ac471b478423ull, 0x0fcf80dc33721d54ull},
+    {0xd1b71758e219652bull, 0xd3c36113404ea4a9ull}, {0x83126e978d4fdf3bull, 0x645a1cac083126eaull},
+    {0xa3d70a3d70a3d70aull, 0x3d70a3d70a3d70a4ull}, {0xccccccccccccccccull, 0xcccccccccccccccdull},
+    {0x8000000000000000ull, 0x0000000000000000ull}, {0xa000000000000000ull, 0x0000000000000000ull},
+    {0xc800000000000000ull, 0x0000000000000000ull}, {0xfa00000000000000ull, 0x0000000000000000ull},
+    {0x9c40000000000000ull, 0x0000000000000000ull}, {0xc350000000000000ull, 0x0000000000000000ull},
+    {0xf424000000000000ull, 0x0000000000000000ull}, {0x9896800000000000ull, 0x0000000000000000ull},
+    {0xbebc200000000000ull, 0x0000000000000000ull}, {0xee6b280000000000ull, 0x0000000000000000ull},
+    {0x9502f90000000000ull, 0x0000000000000000ull}, {0xba43b74000000000ull, 0x0000000000000000ull},
+    {0xe8d4a51000000000ull, 0x0000000000000000ull}, {0x9184e72a00000000ull, 0x0000000000000000ull},
+    {0xb5e620f480000000ull, 0x0000000000000000ull}, {0xe35fa931a0000000ull, 0x0000000000000000ull},
+    {0x8e1bc9bf04000000ull, 0x0000000000000000ull}, {0xb1a2bc2ec5000000ull, 0x0000000000000000ull},
+    {0xde0b6b3a76400000ull, 0x0000000000000000ull}, {0x8ac7230489e80000ull, 0x0000000000000000ull},
+    {0xad78ebc5ac620000ull, 0x0000000000000000ull}, {0xd8d726b7177a8000ull, 0x0000000000000000ull},
+    {0x878678326eac9000ull, 0x0000000000000000ull}, {0xa968163f0a57b400ull, 0x0000000000000000ull},
+    {0xd3c21bcecceda100ull, 0x0000000000000000ull}, {0x84595161401484a0ull, 0x0000000000000000ull},
+    {0xa56fa5b99019a5c8ull, 0x0000000000000000ull}, {0xcecb8f27f4200f3aull, 0x0000000000000000ull},
+    {0x813f3978f8940984ull, 0x4000000000000000ull}, {0xa18f07d736b90be5ull, 0x5000000000000000ull},
+    {0xc9f2c9cd04674edeull, 0xa400000000000000ull}, {0xfc6f7c4045812296ull, 0x4d00000000000000ull},
+    {0x9dc5ada82b70b59dull, 0xf020000000000000ull}, {0xc5371912364ce305ull, 0x6c28000000000000ull},
+    {0xf684df56c3e01bc6ull, 0xc732000000000000ull}, {0x9a130b963a6c115cull, 0x3c7f400000000000ull},
+    {0xc097ce7bc90715b3ull, 0x4b9f100000000000ull}, {0xf0bdc21abb48db20ull, 0x1e86d40000000000ull},
+    {0x96769950b50d88f4ull, 0x1314448000000000ull}, {0xbc143fa4e250eb31ull, 0x17d955a000000000ull},
+    {0xeb194f8e1ae525fdull, 0x5dcfab0800000000ull}, {0x92efd1b8d0cf37beull, 0x5aa1cae500000000ull},
+    {0xb7abc627050305adull, 0xf14a3d9e40000000ull}, {0xe596b7b0c643c719ull, 0x6d9ccd05d0000000ull},
+    {0x8f7e32ce7bea5c6full, 0xe4820023a2000000ull}, {0xb35dbf821ae4f38bull, 0xdda2802c8a800000ull},
+    {0xe0352f62a19e306eull, 0xd50b2037ad200000ull}, {0x8c213d9da502de45ull, 0x4526f422cc340000ull},
+    {0xaf298d050e4395d6ull, 0x9670b12b7f410000ull}, {0xdaf3f04651d47b4cull, 0x3c0cdd765f114000ull},
+    {0x88d8762bf324cd0full, 0xa5880a69fb6ac800ull}, {0xab0e93b6efee0053ull, 0x8eea0d047a457a00ull},
+    {0xd5d238a4abe98068ull, 0x72a4904598d6d880ull}, {0x85a36366eb71f041ull, 0x47a6da2b7f864750ull},
+    {0xa70c3c40a64e6c51ull, 0x999090b65f67d924ull}, {0xd0cf4b50cfe20765ull, 0xfff4b4e3f741cf6dull},
+    {0x82818f1281ed449full, 0xbff8f10e7a8921a4ull}, {0xa321f2d7226895c7ull, 0xaff72d52192b6a0dull},
+    {0xcbea6f8ceb02bb39ull, 0x9bf4f8a69f764490ull}, {0xfee50b7025c36a08ull, 0x02f236d04753d5b4ull},
+    {0x9f4f2726179a2245ull, 0x01d762422c946590ull}, {0xc722f0ef9d80aad6ull, 0x424d3ad2b7b97ef5ull},
+    {0xf8ebad2b84e0d58bull, 0xd2e0898765a7deb2ull}, {0x9b934c3b330c8577ull, 0x63cc55f49f88eb2full},
+    {0xc2781f49ffcfa6d5ull, 0x3cbf6b71c76b25fbull}, {0xf316271c7fc3908aull, 0x8bef464e3945ef7aull},
+    {0x97edd871cfda3a56ull, 0x97758bf0e3cbb5acull}, {0xbde94e8e43d0c8ecull, 0x3d52eeed1cbea317ull},
+    {0xed63a231d4c4fb27ull, 0x4ca7aaa863ee4bddull}, {0x945e455f24fb1cf8ull, 0x8fe8caa93e74ef6aull},
+    {0xb975d6b6ee39e436ull, 0xb3e2fd538e122b44ull}, {0xe7d34c64a9c85d44ull, 0x60dbbca87196b616ull},
+    {0x90e40fbeea1d3a4aull, 0xbc8955e946fe31cdull}, {0xb51d13aea4a488ddull, 0x6babab6398bdbe41ull},
+    {0xe264589a4dcdab14ull, 0xc696963c7eed2dd1ull}, {0x8d7eb76070a08aecull, 0xfc1e1de5cf543ca2ull},
+    {0xb0de65388cc8ada8ull, 0x3b25a55f43294bcbull}, {0xdd15fe86affad912ull, 0x49ef0eb713f39ebeull},
+    {0x8a2dbf142dfcc7abull, 0x6e3569326c784337ull}, {0xacb92ed9397bf996ull, 0x49c2c37f07965404ull},
+    {0xd7e77a8f87daf7fbull, 0xdc33745ec97be906ull}, {0x86f0ac99b4e8dafdull, 0x69a028bb3ded71a3ull},
+    {0xa8acd7c0222311bcull, 0xc40832ea0d68ce0cull}, {0xd2d80db02aabd62bull, 0xf50a3fa490c30190ull},
+    {0x83c7088e1aab65dbull, 0x792667c6da79e0faull}, {0xa4b8cab1a1563f52ull, 0x577001b891185938ull},
+    {0xcde6fd5e09abcf26ull, 0xed4c0226b55e6f86ull}, {0x80b05e5ac60b6178ull, 0x544f8158315b05b4ull},
+    {0xa0dc75f1778e39d6ull, 0x696361ae3db1c721ull}, {0xc913936dd571c84cull, 0x03bc3a19cd1e38e9ull},
+    {0xfb5878494ace3a5full, 0x04ab48a04065c723ull}, {0x9d174b2dcec0e47bull, 0x62eb0d64283f9c76ull},
+    {0xc45d1df942711d9aull, 0x3ba5d0bd324f8394ull}, {0xf5746577930d6500ull, 0xca8f44ec7ee36479ull},
+    {0x9968bf6abbe85f20ull, 0x7e998b13cf4e1ecbull}, {0xbfc2ef456ae276e8ull, 0x9e3fedd8c321a67eull},
+    {0xefb3ab16c59b14a2ull, 0xc5cfe94ef3ea101eull}, {0x95d04aee3b80ece5ull, 0xbba1f1d158724a12ull},
+    {0xbb445da9ca61281full, 0x2a8a6e45ae8edc97ull}, {0xea1575143cf97226ull, 0xf52d09d71a3293bdull},
+    {0x924d692ca61be758ull, 0x593c2626705f9c56ull}, {0xb6e0c377cfa2e12eull, 0x6f8b2fb00c77836cull},
+    {0xe498f455c38b997aull, 0x0b6dfb9c0f956447ull}, {0x8edf98b59a373fecull, 0x4724bd4189bd5eacull},
+    {0xb2977ee300c50fe7ull, 0x58edec91ec2cb657ull}, {0xdf3d5e9bc0f653e1ull, 0x2f2967b66737e3edull},
+    {0x8b865b215899f46cull, 0xbd79e0d20082ee74ull}, {0xae67f1e9aec07187ull, 0xecd8590680a3aa11ull},
+    {0xda01ee641a708de9ull, 0xe80e6f4820cc9495ull}, {0x884134fe908658b2ull, 0x3109058d147fdcddull},
+    {0xaa51823e34a7eedeull, 0xbd4b46f0599fd415ull}, {0xd4e5e2cdc1d1ea96ull, 0x6c9e18ac7007c91aull},
+    {0x850fadc09923329eull, 0x03e2cf6bc604ddb0ull}, {0xa6539930bf6bff45ull, 0x84db8346b786151cull},
+    {0xcfe87f7cef46ff16ull, 0xe612641865679a63ull}, {0x81f14fae158c5f6eull, 0x4fcb7e8f3f60c07eull},
+    {0xa26da3999aef7749ull, 0xe3be5e330f38f09dull}, {0xcb090c8001ab551cull, 0x5cadf5bfd3072cc5ull},
+    {0xfdcb4fa002162a63ull, 0x73d9732fc7c8f7f6ull}, {0x9e9f11c4014dda7eull, 0x2867e7fddcdd9afaull},
+    {0xc646d63501a1511dull, 0xb281e1fd541501b8ull}, {0xf7d88bc24209a565ull, 0x1f225a7ca91a4226ull},
+    {0x9ae757596946075full, 0x3375788de9b06958ull}, {0xc1a12d2fc3978937ull, 0x0052d6b1641c83aeull},
+    {0xf209787bb47d6b84ull, 0xc0678c5dbd23a49aull}, {0x9745eb4d50ce6332ull, 0xf840b7ba963646e0ull},
+    {0xbd176620a501fbffull, 0xb650e5a93bc3d898ull}, {0xec5d3fa8ce427affull, 0xa3e51f138ab4cebeull},
+    {0x93ba47c980e98cdfull, 0xc66f336c36b10137ull}, {0xb8a8d9bbe123f017ull, 0xb80b0047445d4184ull},
+    {0xe6d3102ad96cec1dull, 0xa60dc059157491e5ull}, {0x9043ea1ac7e41392ull, 0x87c89837ad68db2full},
+    {0xb454e4a179dd1877ull, 0x29babe4598c311fbull}, {0xe16a1dc9d8545e94ull, 0xf4296dd6fef3d67aull},
+    {0x8ce2529e2734bb1dull, 0x1899e4a65f58660cull}, {0xb01ae745b101e9e4ull, 0x5ec05dcff72e7f8full},
+    {0xdc21a1171d42645dull, 0x76707543f4fa1f73ull}, {0x899504ae72497ebaull, 0x6a06494a791c53a8ull},
+    {0xabfa45da0edbde69ull, 0x0487db9d17636892ull}, {0xd6f8d7509292d603ull, 0x45a9d2845d3c42b6ull},
+    {0x865b86925b9bc5c2ull, 0x0b8a2392ba45a9b2ull}, {0xa7f26836f282b732ull, 0x8e6cac7768d7141eull},
+    {0xd1ef0244af2364ffull, 0x3207d795430cd926ull}, {0x8335616aed761f1full, 0x7f44e6bd49e807b8ull},
+    {0xa402b9c5a8d3a6e7ull, 0x5f16206c9c6209a6ull}, {0xcd036837130890a1ull, 0x36dba887c37a8c0full},
+    {0x802221226be55a64ull, 0xc2494954da2c9789ull}, {0xa02aa96b06deb0fdull, 0xf2db9baa10b7bd6cull},
+    {0xc83553c5c8965d3dull, 0x6f92829494e5acc7ull}, {0xfa42a8b73abbf48cull, 0xcb772339ba1f17f9ull},
+    {0x9c69a97284b578d7ull, 0xff2a760414536efbull}, {0xc38413cf25e2d70dull, 0xfef5138519684abaull},
+    {0xf46518c2ef5b8cd1ull, 0x7eb258665fc25d69ull}, {0x98bf2f79d5993802ull, 0xef2f773ffbd97a61ull},
+    {0xbeeefb584aff8603ull, 0xaafb550ffacfd8faull}, {0xeeaaba2e5dbf6784ull, 0x95ba2a53f983cf38ull},
+    {0x952ab45cfa97a0b2ull, 0xdd945a747bf26183ull}, {0xba756174393d88dfull, 0x94f971119aeef9e4ull},
+    {0xe912b9d1478ceb17ull, 0x7a37cd5601aab85dull}, {0x91abb422ccb812eeull, 0xac62e055c10ab33aull},
+    {0xb616a12b7fe617aaull, 0x577b986b314d6009ull}, {0xe39c49765fdf9d94ull, 0xed5a7e85fda0b80bull},
+    {0x8e41ade9fbebc27dull, 0x14588f13be847307ull}, {0xb1d219647ae6b31cull, 0x596eb2d8ae258fc8ull},
+    {0xde469fbd99a05fe3ull, 0x6fca5f8ed9aef3bbull}, {0x8aec23d680043beeull, 0x25de7bb9480d5854ull},
+    {0xada72ccc20054ae9ull, 0xaf561aa79a10ae6aull}, {0xd910f7ff28069da4ull, 0x1b2ba1518094da04ull},
+    {0x87aa9aff79042286ull, 0x90fb44d2f05d0842ull}, {0xa99541bf57452b28ull, 0x353a1607ac744a53ull},
+    {0xd3fa922f2d1675f2ull, 0x42889b8997915ce8ull}, {0x847c9b5d7c2e09b7ull, 0x69956135febada11ull},
+    {0xa59bc234db398c25ull, 0x43fab9837e699095ull}, {0xcf02b2c21207ef2eull, 0x94f967e45e03f4bbull},
+    {0x8161afb94b44f57dull, 0x1d1be0eebac278f5ull}, {0xa1ba1ba79e1632dcull, 0x6462d92a69731732ull},
+    {0xca28a291859bbf93ull, 0x7d7b8f7503cfdcfeull}, {0xfcb2cb35e702af78ull, 0x5cda735244c3d43eull},
+    {0x9defbf01b061adabull, 0x3a0888136afa64a7ull}, {0xc56baec21c7a1916ull, 0x088aaa1845b8fdd0ull},
+    {0xf6c69a72a3989f5bull, 0x8aad549e57273d45ull}, {0x9a3c2087a63f6399ull, 0x36ac54e2f678864bull},
+    {0xc0cb28a98fcf3c7full, 0x84576a1bb416a7ddull}, {0xf0fdf2d3f3c30b9full, 0x656d44a2a11c51d5ull},
+    {0x969eb7c47859e743ull, 0x9f644ae5a4b1b325ull}, {0xbc4665b596706114ull, 0x873d5d9f0dde1feeull},
+    {0xeb57ff22fc0c7959ull, 0xa90cb506d155a7eaull}, {0x9316ff75dd87cbd8ull, 0x09a7f12442d588f2ull},
+    {0xb7dcbf5354e9beceull, 0x0c11ed6d538aeb2full}, {0xe5d3ef282a242e81ull, 0x8f1668c8a86da5faull},
+    {0x8fa475791a569d10ull, 0xf96e017d694487bcull}, {0xb38d92d760ec4455ull, 0x37c981dcc395a9acull},
+    {0xe070f78d3927556aull, 0x85bbe253f47b1417ull}, {0x8c469ab843b89562ull, 0x93956d7478ccec8eull},
+    {0xaf58416654a6babbull, 0x387ac8d1970027b2ull}, {0xdb2e51bfe9d0696aull, 0x06997b05fcc0319eull},
+    {0x88fcf317f22241e2ull, 0x441fece3bdf81f03ull}, {0xab3c2fddeeaad25aull, 0xd527e81cad7626c3ull},
+    {0xd60b3bd56a5586f1ull, 0x8a71e223d8d3b074ull}, {0x85c7056562757456ull, 0xf6872d5667844e49ull},
+    {0xa738c6bebb12d16cull, 0xb428f8ac016561dbull}, {0xd106f86e69d785c7ull, 0xe13336d701beba52ull},
+    {0x82a45b450226b39cull, 0xecc0024661173473ull}, {0xa34d721642b06084ull, 0x27f002d7f95d0190ull},
+    {0xcc20ce9bd35c78a5ull, 0x31ec038df7b441f4ull}, {0xff290242c83396ceull, 0x7e67047175a15271ull},
+    {0x9f79a169bd203e41ull, 0x0f0062c6e984d386ull}, {0xc75809c42c684dd1ull, 0x52c07b78a3e60868ull},
+    {0xf92e0c3537826145ull, 0xa7709a56ccdf8a82ull}, {0x9bbcc7a142b17ccbull, 0x88a66076400bb691ull},
+    {0xc2abf989935ddbfeull, 0x6acff893d00ea435ull}, {0xf356f7ebf83552feull, 0x0583f6b8c4124d43ull},
+    {0x98165af37b2153deull, 0xc3727a337a8b704aull}, {0xbe1bf1b059e9a8d6ull, 0x744f18c0592e4c5cull},
+    {0xeda2ee1c7064130cull, 0x1162def06f79df73ull}, {0x9485d4d1c63e8be7ull, 0x8addcb5645ac2ba8ull},
+    {0xb9a74a0637ce2ee1ull, 0x6d953e2bd7173692ull}, {0xe8111c87c5c1ba99ull, 0xc8fa8db6ccdd0437ull},
+    {0x910ab1d4db9914a0ull, 0x1d9c9892400a22a2ull}, {0xb54d5e4a127f59c8ull, 0x2503beb6d00cab4bull},
+    {0xe2a0b5dc971f303aull, 0x2e44ae64840fd61dull}, {0x8da471a9de737e24ull, 0x5ceaecfed289e5d2ull},
+    {0xb10d8e1456105dadull, 0x7425a83e872c5f47ull}, {0xdd50f1996b947518ull, 0xd12f124e28f77719ull},
+    {0x8a5296ffe33cc92full, 0x82bd6b70d99aaa6full}, {0xace73cbfdc0bfb7bull, 0x636cc64d1001550bull},
+    {0xd8210befd30efa5aull, 0x3c47f7e05401aa4eull}, {0x8714a775e3e95c78ull, 0x65acfaec34810a71ull},
+    {0xa8d9d1535ce3b396ull, 0x7f1839a741a14d0dull}, {0xd31045a8341ca07cull, 0x1ede48111209a050ull},
+    {0x83ea2b892091e44dull, 0x934aed0aab460432ull}, {0xa4e4b66b68b65d60ull, 0xf81da84d5617853full},
+    {0xce1de40642e3f4b9ull, 0x36251260ab9d668eull}, {0x80d2ae83e9ce78f3ull, 0xc1d72b7c6b426019ull},
+    {0xa1075a24e4421730ull, 0xb24cf65b8612f81full}, {0xc94930ae1d529cfcull, 0xdee033f26797b627ull},
+    {0xfb9b7cd9a4a7443cull, 0x169840ef017da3b1ull}, {0x9d412e0806e88aa5ull, 0x8e1f289560ee864eull},
+    {0xc491798a08a2ad4eull, 0xf1a6f2bab92a27e2ull}, {0xf5b5d7ec8acb58a2ull, 0xae10af696774b1dbull},
+    {0x9991a6f3d6bf1765ull, 0xacca6da1e0a8ef29ull}, {0xbff610b0cc6edd3full, 0x17fd090a58d32af3ull},
+    {0xeff394dcff8a948eull, 0xddfc4b4cef07f5b0ull}, {0x95f83d0a1fb69cd9ull, 0x4abdaf101564f98eull},
+    {0xbb764c4ca7a4440full, 0x9d6d1ad41abe37f1ull}, {0xea53df5fd18d5513ull, 0x84c86189216dc5edull},
+    {0x92746b9be2f8552cull, 0x32fd3cf5b4e49bb4ull}, {0xb7118682dbb66a77ull, 0x3fbc8c33221dc2a1ull},
+    {0xe4d5e82392a40515ull, 0x0fabaf3feaa5334aull}, {0x8f05b1163ba6832dull, 0x29cb4d87f2a7400eull},
+    {0xb2c71d5bca9023f8ull, 0x743e20e9ef511012ull}, {0xdf78e4b2bd342cf6ull, 0x914da9246b255416ull},
+    {0x8bab8eefb6409c1aull, 0x1ad089b6c2f7548eull}, {0xae9672aba3d0c320ull, 0xa184ac2473b529b1ull},
+    {0xda3c0f568cc4f3e8ull, 0xc9e5d72d90a2741eull}, {0x8865899617fb1871ull, 0x7e2fa67c7a658892ull},
+    {0xaa7eebfb9df9de8dull, 0xddbb901b98feeab7ull}, {0xd51ea6fa85785631ull, 0x552a74227f3ea565ull},
+    {0x8533285c936b35deull, 0xd53a88958f87275full}, {0xa67ff273b8460356ull, 0x8a892abaf368f137ull},
+    {0xd01fef10a657842cull, 0x2d2b7569b0432d85ull}, {0x8213f56a67f6b29bull, 0x9c3b29620e29fc73ull},
+    {0xa298f2c501f45f42ull, 0x8349f3ba91b47b8full}, {0xcb3f2f7642717713ull, 0x241c70a936219a73ull},
+    {0xfe0efb53d30dd4d7ull, 0xed238cd383aa0110ull}, {0x9ec95d1463e8a506ull, 0xf4363804324a40aaull},
+    {0xc67bb4597ce2ce48ull, 0xb143c6053edcd0d5ull}, {0xf81aa16fdc1b81daull, 0xdd94b7868e94050aull},
+    {0x9b10a4e5e9913128ull, 0xca7cf2b4191c8326ull}, {0xc1d4ce1f63f57d72ull, 0xfd1c2f611f63a3f0ull},
+    {0xf24a01a73cf2dccfull, 0xbc633b39673c8cecull}, {0x976e41088617ca01ull, 0xd5be0503e085d813ull},
+    {0xbd49d14aa79dbc82ull, 0x4b2d8644d8a74e18ull}, {0xec9c459d51852ba2ull, 0xddf8e7d60ed1219eull},
+    {0x93e1ab8252f33b45ull, 0xcabb90e5c942b503ull}, {0xb8da1662e7b00a17ull, 0x3d6a751f3b936243ull},
+    {0xe7109bfba19c0c9dull, 0x0cc512670a783ad4ull}, {0x906a617d450187e2ull, 0x27fb2b80668b24c5ull},
+    {0xb484f9dc9641e9daull, 0xb1f9f660802dedf6ull}, {0xe1a63853bbd26451ull, 0x5e7873f8a0396973ull},
+    {0x8d07e33455637eb2ull, 0xdb0b487b6423e1e8ull}, {0xb049dc016abc5e5full, 0x91ce1a9a3d2cda62ull},
+    {0xdc5c5301c56b75f7ull, 0x7641a140cc7810fbull}, {0x89b9b3e11b6329baull, 0xa9e904c87fcb0a9dull},
+    {0xac2820d9623bf429ull, 0x546345fa9fbdcd44ull}, {0xd732290fbacaf133ull, 0xa97c177947ad4095ull},
+    {0x867f59a9d4bed6c0ull, 0x49ed8eabcccc485dull}, {0xa81f301449ee8c70ull, 0x5c68f256bfff5a74ull},
+    {0xd226fc195c6a2f8cull, 0x73832eec6fff3111ull}, {0x83585d8fd9c25db7ull, 0xc831fd53c5ff7eabull},
+    {0xa42e74f3d032f525ull, 0xba3e7ca8b77f5e55ull}, {0xcd3a1230c43fb26full, 0x28ce1bd2e55f35ebull},
+    {0x80444b5e7aa7cf85ull, 0x7980d163cf5b81b3ull}, {0xa0555e361951c366ull, 0xd7e105bcc332621full},
+    {0xc86ab5c39fa63440ull, 0x8dd9472bf3fefaa7ull}, {0xfa856334878fc150ull, 0xb14f98f6f0feb951ull},
+    {0x9c935e00d4b9d8d2ull, 0x6ed1bf9a569f33d3ull}, {0xc3b8358109e84f07ull, 0x0a862f80ec4700c8ull},
+    {0xf4a642e14c6262c8ull, 0xcd27bb612758c0faull}, {0x98e7e9cccfbd7dbdull, 0x8038d51cb897789cull},
+    {0xbf21e44003acdd2cull, 0xe0470a63e6bd56c3ull}, {0xeeea5d5004981478ull, 0x1858ccfce06cac74ull},
+    {0x95527a5202df0ccbull, 0x0f37801e0c43ebc8ull}, {0xbaa718e68396cffdull, 0xd30560258f54e6baull},
+    {0xe950df20247c83fdull, 0x47c6b82ef32a2069ull}, {0x91d28b7416cdd27eull, 0x4cdc331d57fa5441ull},
+    {0xb6472e511c81471dull, 0xe0133fe4adf8e952ull}, {0xe3d8f9e563a198e5ull, 0x58180fddd97723a6ull},
+    {0x8e679c2f5e44ff8full, 0x570f09eaa7ea7648ull}, {0xb201833b35d63f73ull, 0x2cd2cc6551e513daull},
+    {0xde81e40a034bcf4full, 0xf8077f7ea65e58d1ull}, {0x8b112e86420f6191ull, 0xfb04afaf27faf782ull},
+    {0xadd57a27d29339f6ull, 0x79c5db9af1f9b563ull}, {0xd94ad8b1c7380874ull, 0x18375281ae7822bcull},
+    {0x87cec76f1c830548ull, 0x8f2293910d0b15b5ull}, {0xa9c2794ae3a3c69aull, 0xb2eb3875504ddb22ull},
+    {0xd433179d9c8cb841ull, 0x5fa60692a46151ebull}, {0x849feec281d7f328ull, 0xdbc7c41ba6bcd333ull},
+    {0xa5c7ea73224deff3ull, 0x12b9b522906c0800ull}, {0xcf39e50feae16befull, 0xd768226b34870a00ull},
+    {0x81842f29f2cce375ull, 0xe6a1158300d46640ull}, {0xa1e53af46f801c53ull, 0x60495ae3c1097fd0ull},
+    {0xca5e89b18b602368ull, 0x385bb19cb14bdfc4ull}, {0xfcf62c1dee382c42ull, 0x46729e03dd9ed7b5ull},
+    {0x9e19db92b4e31ba9ull, 0x6c07a2c26a8346d1ull},
+};
+
+// Eisel-Lemire for w != 0: sets '*bits' to the binary64 nearest to w * 10^q, or returns 0
+// when that cannot be decided from 128 bits of the power of five.
+static int
+json_eisel_lemire(uint64_t w, int64_t q, uint64_t *bits)
+{
+    if (q < -342) {
+        *bits = 0;
+        return 1;
+    }
+    if (q > 308) {
+        *bits = 0x7ff0000000000000ull;
+        return 1;
+    }
+
+    const int lz = __builtin_clzll(w);
+    w <<= lz;
+    const uint64_t *p5 = json_pow5_128[q + 342];
+    const unsigned __int128 first = (unsigned __int128) w * p5[0];
+    uint64_t hi = first >> 64, lo = (uint64_t) first;
+    if ((hi & 0x1ff) == 0x1ff) {
+        // the truncated low bits may carry into the 55 bits that matter
+        const uint64_t second = ((unsigned __int128) w * p5[1]) >> 64;
+        lo += second;
+        hi += lo < second;
+        if (lo == UINT64_MAX && (q < -27 || q > 55)) {
+            return 0;
+        }
+    }
+
+    const int upper = hi >> 63;
+    const int shift = upper + 64 - 52 - 3;
+    uint64_t m = hi >> shift;
+    // floor(log2(10^q)) + 63 + the normalizations, biased
+    int64_t e2 = ((217706 * q) >> 16) + 63 + upper - lz + 1023;
+
+    if (e2 <= 0) {
+        // subnormal
+        if (-e2 + 1 >= 64) {
+            *bits = 0;
+            return 1;
+        }
+        m >>= -e2 + 1;
+        m += m & 1;
+        m >>= 1;
+        *bits = m | (uint64_t) (m >= 1ull << 52) << 52;
+        return 1;
+    }
+
+    // exactly halfway between two doubles: round to even instead of up
+    if (lo <= 1 && q >= -4 && q <= 23 && (m & 3) == 1 && m << shift == hi) {
+        m &= ~1ull;
+    }
+    m += m & 1;
+    m >>= 1;
+    if (m >= 2ull << 52) {
+        m = 1ull << 52;
+        ++e2;
+    }
+    if (e2 >= 0x7ff) {
+        *bits = 0x7ff0000000000000ull;
+        return 1;
+    }
+    *bits = (uint64_t) e2 << 52 | (m & ((1ull << 52) - 1));
+    return 1;
+}
+
+static double
+json_number_strtod(const char *s, const char *end)
+{
+    char tmp[128];
+    const size_t n = end - s;
+    char *p = n < sizeof(tmp) ? tmp : malloc(n + 1);
+    if (!p) {
+        return 0;
+    }
+    memcpy(p, s, n);
+    p[n] = 0;
+    const double d = strtod(p, NULL);
+    if (p != tmp) {
+        free(p);
+    }
+    return d;
+}
+
+// Converts any JSON number, rounding to nearest; out of range values become 0 or infinity.
+int
+json_number_double(const char *s, const char *end, double *out)
+{
+    static const double pow10[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+    };
+
+    JsonNumber n;
+    if (!json_number_scan(s, end, &n)) {
+        return 0;
+    }
+    if (!n.exact) {
+        *out = json_number_strtod(s, end);
+        return 1;
+    }
+
+    double d;
+    uint64_t bits;
+    if (!n.w) {
+        d = 0;
+#if __FLT_EVAL_METHOD__ == 0
+    } else if (n.w <= 1ull << 53 && n.q >= -22 && n.q <= 22) {
+        d = (double) n.w;
+        d = n.q < 0 ? d / pow10[-n.q] : d * pow10[n.q];
+#endif
+    } else if (json_eisel_lemire(n.w, n.q, &bits)) {
+        memcpy(&d, &bits, sizeof(d));
+    } else {
+        *out = json_number_strtod(s, end);
+        return 1;
+    }
+    *out = n.neg ? -d : d;
+    return 1;
+}
+
+//-----------------------------------------------------------------------------
+// Strings: UTF-8 validation and unescaping of the contents between the quotes.
+//
+// The vectorised validator is the Keiser-Lemire "lookup" algorithm: the high and low nibble
+// of each byte and the high nibble of the next one index three 16-entry tables whose AND is
+// non-zero exactly for the invalid 2-byte sequences (too short, too long, overlong,
+// surrogate, above U+10FFFF); a third or fourth continuation byte is checked against the lead
+// 2 or 3 bytes before it.
+
+static int
+json_utf8_valid_scalar(const unsigned char *s, const unsigned char *end)
+{
+    while (s != end) {
+        if (end - s >= 8 && !(json_load8((const char *) s) & 0x8080808080808080ull)) {
+            s += 8;
+            continue;
+        }
+        const unsigned c = *s;
+        if (c < 0x80) {
+            ++s;
+            continue;
+        }
+        size_t n;
+        unsigned lo = 0x80, hi = 0xbf; // range of the second byte
+        if (c >= 0xc2 && c <= 0xdf) {
+            n = 2;
+        } else if (c >= 0xe0 && c <= 0xef) {
+            n = 3;
+            if (c == 0xe0) { lo = 0xa0; }
+            if (c == 0xed) { hi = 0x9f; }
+        } else if (c >= 0xf0 && c <= 0xf4) {
+            n = 4;
+            if (c == 0xf0) { lo = 0x90; }
+            if (c == 0xf4) { hi = 0x8f; }
+        } else {
+            return 0;
+        }
+        if ((size_t) (end - s) < n || s[1] < lo || s[1] > hi) {
+            return 0;
+        }
+        for (size_t i = 2; i < n; ++i) {
+            if ((s[i] & 0xc0) != 0x80) {
+                return 0;
+            }
+        }
+        s += n;
+    }
+    return 1;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("avx2")))
+static int
+json_utf8_valid_avx2(const unsigned char *s, const unsigned char *end)
+{
+    enum {
+        TOO_SHORT = 1 << 0,     // lead byte not followed by a continuation
+        TOO_LONG = 1 << 1,      // ASCII followed by a continuation
+        OVERLONG_3 = 1 << 2,    // E0 80..9F
+        TOO_LARGE = 1 << 3,     // F4 90..BF, F5..FF
+        SURROGATE = 1 << 4,     // ED A0..BF
+        OVERLONG_2 = 1 << 5,    // C0..C1
+        TOO_LARGE_1000 = 1 << 6,
+        OVERLONG_4 = 1 << 6,    // F0 80..8F
+        TWO_CONTS = 1 << 7,     // continuation followed by a continuation
+        CARRY = TOO_SHORT | TOO_LONG | TWO_CONTS,
+    };
+#define TABLE(...) _mm256_setr_epi8(__VA_ARGS__, __VA_ARGS__)
+    const __m256i byte_1_high = TABLE(
+        TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+        TWO_CONTS, TWO_CONTS, TWO_CONTS, TWO_CONTS,
+        TOO_SHORT | OVERLONG_2,
+        TOO_SHORT,
+        TOO_SHORT | OVERLONG_3 | SURROGATE,
+        TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4);
+    const __m256i byte_1_low = TABLE(
+        CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4,
+        CARRY | OVERLONG_2,
+        CARRY,
+        CARRY,
+        CARRY | TOO_LARGE,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000 | SURROGATE,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000);
+    const __m256i byte_2_high = TABLE(
+        TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE_1000 | OVERLONG_4,
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE,
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+        TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT);
+#undef TABLE
+    const __m256i nib = _mm256_set1_epi8(0x0f);
+    // the last 3 bytes of a block must not start a sequence that needs more bytes
+    const __m256i max_end = _mm256_setr_epi8(
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        (char) (0xf0 - 1), (char) (0xe0 - 1), (char) (0xc0 - 1));
+
+    __m256i prev = _mm256_setzero_si256(), err = prev, incomplete = prev;
+    unsigned char tail[32];
+    while (s != end) {
+        __m256i v;
+        if (end - s >= 32) {
+            v = _mm256_loadu_si256((const __m256i *) s);
+            s += 32;
+        } else {
+            memset(tail, 0, sizeof(tail));
+            memcpy(tail, s, end - s);
+            v = _mm256_loadu_si256((const __m256i *) tail);
+            s = end;
+        }
+
+        if (!_mm256_movemask_epi8(v)) {
+            // ASCII: only a sequence cut at the end of the previous block can be wrong
+            err = _mm256_or_si256(err, incomplete);
+            prev = v;
+            incomplete = _mm256_setzero_si256();
+            continue;
+        }
+
+        const __m256i shifted = _mm256_permute2x128_si256(prev, v, 0x21);
+        const __m256i prev1 = _mm256_alignr_epi8(v, shifted, 15);
+        const __m256i prev2 = _mm256_alignr_epi8(v, shifted, 14);
+        const __m256i prev3 = _mm256_alignr_epi8(v, shifted, 13);
+        const __m256i sc = _mm256_and_si256(
+            _mm256_and_si256(
+                _mm256_shuffle_epi8(byte_1_high,
+                                    _mm256_and_si256(_mm256_srli_epi16(prev1, 4), nib)),
+                _mm256_shuffle_epi8(byte_1_low, _mm256_and_si256(prev1, nib))),
+            _mm256_shuffle_epi8(byte_2_high, _mm256_and_si256(_mm256_srli_epi16(v, 4), nib)));
+        const __m256i must23 = _mm256_or_si256(
+            _mm256_subs_epu8(prev2, _mm256_set1_epi8((char) (0xe0 - 0x80))),
+            _mm256_subs_epu8(prev3, _mm256_set1_epi8((char) (0xf0 - 0x80))));
+        const __m256i must23_80 = _mm256_and_si256(must23, _mm256_set1_epi8((char) 0x80));
+        err = _mm256_or_si256(err, _mm256_xor_si256(must23_80, sc));
+
+        prev = v;
+        incomplete = _mm256_subs_epu8(v, max_end);
+    }
+    err = _mm256_or_si256(err, incomplete);
+    return _mm256_testz_si256(err, err);
+}
+#endif
+
+typedef int (*JsonUtf8Func)(const unsigned char *s, const unsigned char *end);
+
+static JsonUtf8Func json_utf8_impl;
+
+int
+json_utf8_valid(const char *s, const char *end)
+{
+    if (!json_utf8_impl) {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_cpu_init();
+        json_utf8_impl = __builtin_cpu_supports("avx2")
+            ? json_utf8_valid_avx2 : json_utf8_valid_scalar;
+#else
+        json_utf8_impl = json_utf8_valid_scalar;
+#endif
+    }
+    // short strings are not worth the padding of the last vector
+    if (end - s < 32) {
+        return json_utf8_valid_scalar((const unsigned char *) s, (const unsigned char *) end);
+    }
+    return json_utf8_impl((const unsigned char *) s, (const unsigned char *) end);
+}
+
+// Returns the first byte of '[s, end)' that cannot be in a JSON string as is: a quote, a
+// backslash or a control character.
+static const char *
+json_escape_scan_scalar(const char *s, const char *end)
+{
+    const uint64_t ones = 0x0101010101010101ull, highs = 0x8080808080808080ull;
+    for (; end - s >= 8; s += 8) {
+        const uint64_t v = json_load8(s);
+        const uint64_t q = v ^ (ones * '"'), b = v ^ (ones * '\\');
+        const uint64_t m = ((q - ones) & ~q) | ((b - ones) & ~b) | ((v - ones * 0x20) & ~v);
+        if (m & highs) {
+            return s + __builtin_ctzll(m & highs) / 8;
+        }
+    }
+    for (; s != end; ++s) {
+        const unsigned char c = *s;
+        if (c == '"' || c == '\\' || c < 0x20) {
+            break;
+        }
+    }
+    return s;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("sse2")))
+static const char *
+json_escape_scan_sse2(const char *s, const char *end)
+{
+    for (; end - s >= 16; s += 16) {
+        const __m128i v = _mm_loadu_si128((const __m128i *) s);
+        const __m128i m = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('"')),
+                         _mm_cmpeq_epi8(v, _mm_set1_epi8('\\'))),
+            _mm_cmpeq_epi8(_mm_subs_epu8(v, _mm_set1_epi8(0x1f)), _mm_setzero_si128()));
+        const unsigned mask = _mm_movemask_epi8(m);
+        if (mask) {
+            return s + __builtin_ctz(mask);
+        }
+    }
+    return json_escape_scan_scalar(s, end);
+}
+
+__attribute__((target("avx2")))
+static const char *
+json_escape_scan_avx2(const char *s, const char *end)
+{
+    for (; end - s >= 32; s += 32) {
+        const __m256i v = _mm256_loadu_si256((const __m256i *) s);
+        const __m256i m = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('"')),
+                            _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\\'))),
+            _mm256_cmpeq_epi8(_mm256_subs_epu8(v, _mm256_set1_epi8(0x1f)), _mm256_setzero_si256()));
+        const unsigned mask = _mm256_movemask_epi8(m);
+        if (mask) {
+            return s + __builtin_ctz(mask);
+        }
+    }
+    return json_escape_scan_sse2(s, end);
+}
+#endif
+
+typedef const char *(*JsonEscapeScanFunc)(const char *s, const char *end);
+
+static inline int
+json_hex4(const char *s, unsigned *cp)
+{
+    unsigned v = 0;
+    for (int i = 0; i < 4; ++i) {
+        const unsigned c = (unsigned char) s[i];
+        unsigned d;
+        if (c - '0' < 10u) {
+            d = c - '0';
+        } else if ((c | 0x20) - 'a' < 6u) {
+            d = (c | 0x20) - 'a' + 10;
+        } else {
+            return 0;
+        }
+        v = v << 4 | d;
+    }
+    *cp = v;
+    return 1;
+}
+
+// Decodes the escape sequence at 's' (the backslash) into '*out'. Returns the end of the
+// sequence, or NULL if it is invalid. Lone surrogates are invalid.
+static const char *
+json_unescape_one(const char *s, const char *end, char **out)
+{
+    static const char simple[256] = {
+        ['"'] = '"', ['\\'] = '\\', ['/'] = '/',
+        ['b'] = '\b', ['f'] = '\f', ['n'] = '\n', ['r'] = '\r', ['t'] = '\t',
+    };
+
+    if (end - s < 2) {
+        return NULL;
+    }
+    if (s[1] != 'u') {
+        const char c = simple[(unsigned char) s[1]];
+        if (!c) {
+            return NULL;
+        }
+        *(*out)++ = c;
+        return s + 2;
+    }
+
+    unsigned cp;
+    if (end - s < 6 || !json_hex4(s + 2, &cp)) {
+        return NULL;
+    }
+    s += 6;
+    if (cp >= 0xd800 && cp <= 0xdfff) {
+        unsigned lo;
+        if (cp >= 0xdc00 || end - s < 6 || s[0] != '\\' || s[1] != 'u'
+            || !json_hex4(s + 2, &lo) || lo < 0xdc00 || lo > 0xdfff)
+        {
+            return NULL;
+        }
+        cp = 0x10000 + ((cp - 0xd800) << 10) + (lo - 0xdc00);
+        s += 6;
+    }
+
+    unsigned char *o = (unsigned char *) *out;
+    if (cp < 0x80) {
+        *o++ = cp;
+    } else if (cp < 0x800) {
+        *o++ = 0xc0 | cp >> 6;
+        *o++ = 0x80 | (cp & 0x3f);
+    } else if (cp < 0x10000) {
+        *o++ = 0xe0 | cp >> 12;
+        *o++ = 0x80 | (cp >> 6 & 0x3f);
+        *o++ = 0x80 | (cp & 0x3f);
+    } else {
+        *o++ = 0xf0 | cp >> 18;
+        *o++ = 0x80 | (cp >> 12 & 0x3f);
+        *o++ = 0x80 | (cp >> 6 & 0x3f);
+        *o++ = 0x80 | (cp & 0x3f);
+    }
+    *out = (char *) o;
+    return s;
+}
+
+// Handles the byte at 's', which needs attention: a backslash, a quote or a control
+// character. Returns where to continue, or NULL if the string is invalid.
+static inline const char *
+json_unescape_special(const char *s, const char *end, char **out)
+{
+    if (*s != '\\') {
+        return NULL;
+    }
+    return json_unescape_one(s, end, out);
+}
+
+static const char *
+json_unescape_scalar(const char *s, const char *end, char *out, char **out_end)
+{
+    while (1) {
+        const char *q = json_escape_scan_scalar(s, end);
+        memmove(out, s, q - s);
+        out += q - s;
+        if (q == end) {
+            break;
+        }
+        if (!(s = json_unescape_special(q, end, &out))) {
+            return NULL;
+        }
+    }
+    *out_end = out;
+    return end;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+// Stores 16 (32) bytes at a time unconditionally: the output is never ahead of the input,
+// so that stays within 'end - s' bytes of 'out' as long as that many input bytes are left.
+
+__attribute__((target("sse2")))
+static const char *
+json_unescape_sse2(const char *s, const char *end, char *out, char **out_end)
+{
+    while (end - s >= 16) {
+        const __m128i v = _mm_loadu_si128((const __m128i *) s);
+        _mm_storeu_si128((__m128i *) out, v);
+        const __m128i special = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\\')),
+                         _mm_cmpeq_epi8(v, _mm_set1_epi8('"'))),
+            _mm_cmpeq_epi8(_mm_subs_epu8(v, _mm_set1_epi8(0x1f)), _mm_setzero_si128()));
+        const unsigned mask = _mm_movemask_epi8(special);
+        if (!mask) {
+            s += 16;
+            out += 16;
+            continue;
+        }
+        const unsigned k = __builtin_ctz(mask);
+        s += k;
+        out += k;
+        if (!(s = json_unescape_special(s, end, &out))) {
+            return NULL;
+        }
+    }
+    return json_unescape_scalar(s, end, out, out_end);
+}
+
+__attribute__((target("avx2")))
+static const char *
+json_unescape_avx2(const char *s, const char *end, char *out, char **out_end)
+{
+    while (end - s >= 32) {
+        const __m256i v = _mm256_loadu_si256((const __m256i *) s);
+        _mm256_storeu_si256((__m256i *) out, v);
+        const __m256i special = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\\')),
+                            _mm256_cmpeq_epi8(v, _mm256_set1_epi8('"'))),
+            _mm256_cmpeq_epi8(_mm256_subs_epu8(v, _mm256_set1_epi8(0x1f)), _mm256_setzero_si256()));
+        const unsigned mask = _mm256_movemask_epi8(special);
+        if (!mask) {
+            s += 32;
+            out += 32;
+            continue;
+        }
+        const unsigned k = __builtin_ctz(mask);
+        s += k;
+        out += k;
+        if (!(s = json_unescape_special(s, end, &out))) {
+            return NULL;
+        }
+    }
+    return json_unescape_sse2(s, end, out, out_end);
+}
+#endif
+
+typedef const char *(*JsonUnescapeFunc)(const char *s, const char *end, char *out, char **out_end);
+
+static JsonUnescapeFunc json_unescape_impl;
+
+// Unescapes the contents of a string, '[s, end)' without the quotes, into 'out', which has
+// room for 'end - s' bytes (the result is never longer), and sets '*len'. Returns 0 if there
+// is an invalid escape, an unescaped quote or control character, or invalid UTF-8.
+int
+json_string_unescape(const char *s, const char *end, char *out, size_t *len)
+{
+    if (!json_unescape_impl) {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_cpu_init();
+        json_unescape_impl = __builtin_cpu_supports("avx2") ? json_unescape_avx2
+            : __builtin_cpu_supports("sse2") ? json_unescape_sse2 : json_unescape_scalar;
+#else
+        json_unescape_impl = json_unescape_scalar;
+#endif
+    }
+
+    // escapes are ASCII, so the raw bytes are valid UTF-8 if and only if the result is
+    if (!json_utf8_valid(s, end)) {
+        return 0;
+    }
+    char *o;
+    if (!json_unescape_impl(s, end, out, &o)) {
+        return 0;
+    }
+    *len = o - out;
+    return 1;
+}
+
+//-----------------------------------------------------------------------------
+// NDJSON driver: a file of one document per line, mmap'd and cut into chunks that worker
+// threads process in parallel.
+//
+// A chunk nominally starts every 'chunk_size' bytes and really starts after the first
+// newline at or after that, so each worker finds its own boundaries and a line belongs to the
+// chunk its first byte is in. A worker calls 'line' for every non-empty line of its chunk, or
+// every line with 'empty_lines' (with the newline and a trailing '\r' removed), giving it the
+// chunk's result and a tape of its own to parse into. The calling thread passes the results
+// to 'merge' in input order. Workers can only run 4 chunks per thread ahead of the merge,
+// which bounds the number of results: a result is zeroed once, and after that 'merge' has to
+// reset it for reuse (which lets it keep its allocations). At the end every result is passed
+// to 'release', if set, to free them.
+
+typedef struct {
+    void (*line)(void *arg, void *result, JsonTape *tape, const char *s, const char *end);
+    void (*merge)(void *arg, void *result);
+    void (*release)(void *arg, void *result);
+    size_t result_size;
+    void *arg;
+
+    int nthreads;      // 0: one per online CPU
+    size_t chunk_size; // 0: 1 MiB
+    int hugepages;     // ask for huge pages on the mapping (MADV_HUGEPAGE)
+    int empty_lines;   // also call 'line' for empty lines
+} JsonNdjson;
+
+typedef struct {
+    const JsonNdjson *nd;
+    const char *map;
+    size_t size;
+    size_t nchunks;
+    size_t window;
+    size_t readahead; // chunks
+    char *results;
+    unsigned char *done;
+
+    pthread_mutex_t lock;
+    pthread_cond_t cond_done;
+    pthread_cond_t cond_free;
+    size_t next;   // next chunk to claim
+    size_t merged; // chunks merged
+} JsonNdjsonRun;
+
+static const char *
+json_ndjson_chunk_start(const JsonNdjsonRun *r, size_t i)
+{
+    const char *end = r->map + r->size;
+    if (!i) {
+        return r->map;
+    }
+    if (i >= r->nchunks) {
+        return end;
+    }
+    const char *p = r->map + i * r->nd->chunk_size - 1;
+    const char *nl = memchr(p, '\n', end - p);
+    return nl ? nl + 1 : end;
+}
+
+static void
+json_ndjson_willneed(const JsonNdjsonRun *r, size_t i)
+{
+    if (i >= r->nchunks) {
+        return;
+    }
+    const long page = sysconf(_SC_PAGESIZE);
+    const size_t from = (i * r->nd->chunk_size) & ~(size_t) (page - 1);
+    size_t to = (i + 1) * r->nd->chunk_size;
+    if (to > r->size) {
+        to = r->size;
+    }
+    madvise((char *) r->map + from, to - from, MADV_WILLNEED);
+}
+
+static void *
+json_ndjson_worker(void *arg)
+{
+    JsonNdjsonRun *r = arg;
+    const JsonNdjson *nd = r->nd;
+    JsonTape tape;
+    json_tape_init(&tape);
+
+    pthread_mutex_lock(&r->lock);
+    while (1) {
+        while (r->next < r->nchunks && r->next >= r->merged + r->window) {
+            pthread_cond_wait(&r->cond_free, &r->lock);
+        }
+        if (r->next >= r->nchunks) {
+            break;
+        }
+        const size_t i = r->next++;
+        pthread_mutex_unlock(&r->lock);
+
+        json_ndjson_willneed(r, i + r->readahead);
+        void *result = r->results + (i % r->window) * nd->result_size;
+        const char *s = json_ndjson_chunk_start(r, i), *end = json_ndjson_chunk_start(r, i + 1);
+        while (s != end) {
+            const char *nl = memchr(s, '\n', end - s);
+            const char *e = nl ? nl : end;
+            const char *le = e != s && e[-1] == '\r' ? e - 1 : e;
+            if (le != s || nd->empty_lines) {
+                nd->line(nd->arg, result, &tape, s, le);
+            }
+            s = nl ? nl + 1 : end;
+        }
+
+        pthread_mutex_lock(&r->lock);
+        r->done[i % r->window] = 1;
+        pthread_cond_signal(&r->cond_done);
+    }
+    pthread_mutex_unlock(&r->lock);
+
+    json_tape_free(&tape);
+    return NULL;
+}
+
+// Runs 'nd' over the file at 'path'. Returns 0, or -1 with errno set if the file cannot be
+// mapped or no thread can be started.
+int
+json_ndjson_file(const char *path, const JsonNdjson *nd_)
+{
+    JsonNdjson nd = *nd_;
+    if (nd.nthreads <= 0) {
+        const long n = sysconf(_SC_NPROCESSORS_ONLN);
+        nd.nthreads = n > 0 ? n : 1;
+    }
+    if (!nd.chunk_size) {
+        nd.chunk_size = 1 << 20;
+    }
+
+    const int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        return -1;
+    }
+    if (!st.st_size) {
+        close(fd);
+        return 0;
+    }
+    char *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return -1;
+    }
+    madvise(map, st.st_size, MADV_SEQUENTIAL);
+#ifdef MADV_HUGEPAGE
+    if (nd.hugepages) {
+        madvise(map, st.st_size, MADV_HUGEPAGE);
+    }
+#endif
+
+    JsonNdjsonRun r = {
+        .nd = &nd,
+        .map = map,
+        .size = st.st_size,
+        .nchunks = (st.st_size + nd.chunk_size - 1) / nd.chunk_size,
+        .window = 4 * (size_t) nd.nthreads,
+        .readahead = nd.nthreads,
+        .lock = PTHREAD_MUTEX_INITIALIZER,
+        .cond_done = PTHREAD_COND_INITIALIZER,
+        .cond_free = PTHREAD_COND_INITIALIZER,
+    };
+    r.results = calloc(r.window, nd.result_size ? nd.result_size : 1);
+    r.done = calloc(r.window, 1);
+    pthread_t *threads = malloc(nd.nthreads * sizeof(*threads));
+    int nstarted = 0, ret = 0, err = ENOMEM;
+    if (r.results && r.done && threads) {
+        for (size_t i = 0; i < r.readahead; ++i) {
+            json_ndjson_willneed(&r, i);
+        }
+        for (; nstarted < nd.nthreads; ++nstarted) {
+            if ((err = pthread_create(&threads[nstarted], NULL, json_ndjson_worker, &r))) {
+                break;
+            }
+        }
+    }
+    if (!nstarted) {
+        ret = -1;
+        errno = err;
+    } else {
+        pthread_mutex_lock(&r.lock);
+        while (r.merged < r.nchunks) {
+            const size_t slot = r.merged % r.window;
+            while (!r.done[slot]) {
+                pthread_cond_wait(&r.cond_done, &r.lock);
+            }
+            pthread_mutex_unlock(&r.lock);
+            nd.merge(nd.arg, r.results + slot * nd.result_size);
+            pthread_mutex_lock(&r.lock);
+            r.done[slot] = 0;
+            ++r.merged;
+            pthread_cond_broadcast(&r.cond_free);
+        }
+        pthread_mutex_unlock(&r.lock);
+        for (int i = 0; i < nstarted; ++i) {
+            pthread_join(threads[i], NULL);
+        }
+    }
+
+    if (r.results && nd.release) {
+        for (size_t i = 0; i < r.window; ++i) {
+            nd.release(nd.arg, r.results + i * nd.result_size);
+        }
+    }
+    free(threads);
+    free(r.done);
+    free(r.results);
+    munmap(map, st.st_size);
+    return ret;
+}
+
+//-----------------------------------------------------------------------------
+// Path queries: extracting a few fields, given as paths like '.a.b[3].c', in one pass over a
+// document, without building anything. The paths are compiled into a trie of steps; at each
+// map (list) the keys (indices) are matched against the children of the current step, and
+// whatever does not match is skipped with json_skip_fast(). Keys are compared as they are
+// written in the document, escapes included. Once every field has been found, the rest of the
+// document is not looked at. A path given more than once is looked up once and copied.
+//
+//   path := '.' | step+
+//   step := '.' key | '[' digits ']'
+//   key  := any bytes but '.' and '[', at least one
+
+typedef struct {
+    const char *key; // NULL for an index step
+    size_t len;      // length of 'key', or the index
+    size_t child;    // first child, 0 for none
+    size_t next;     // next sibling, 0 for none
+    size_t nfields;  // fields at or under this step
+    int field;       // the path ending here, or -1
+} JsonQueryStep;
+
+typedef struct {
+    JsonQueryStep *steps; // steps[0] is the document itself
+    size_t nsteps;
+    size_t nfields;
+    size_t *same; // per field: the first field with the same path, often itself
+} JsonQuery;
+
+typedef struct {
+    JsonTokenType type; // JTT_EOT if not found
+    const char *start;  // the value as written, quotes and brackets included
+    const char *end;
+} JsonQueryField;
+
+void
+json_query_free(JsonQuery *q)
+{
+    free(q->steps);
+    free(q->same);
+    *q = (JsonQuery) {0};
+}
+
+// Compiles 'paths', which have to stay valid while the query is used. Returns 0, or -1 if a
+// path is malformed or out of memory.
+int
+json_query_compile(JsonQuery *q, const char *const *paths, size_t npaths)
+{
+    size_t cap = 1;
+    for (size_t i = 0; i < npaths; ++i) {
+        cap += strlen(paths[i]);
+    }
+    *q = (JsonQuery) {
+        .steps = malloc(cap * sizeof(*q->steps)),
+        .nsteps = 1,
+        .same = malloc(npaths * sizeof(*q->same)),
+    };
+    if (!q->steps || (!q->same && npaths)) {
+        json_query_free(q);
+        return -1;
+    }
+    q->steps[0] = (JsonQueryStep) {.field = -1};
+
+    for (size_t i = 0; i < npaths; ++i) {
+        const char *p = paths[i];
+        size_t at = 0;
+        if (!strcmp(p, ".")) {
+            p += 1;
+        } else if (!*p) {
+            json_query_free(q);
+            return -1;
+        }
+        while (*p) {
+            JsonQueryStep step = {.field = -1};
+            if (*p == '.') {
+                step.key = ++p;
+                while (*p && *p != '.' && *p != '[') {
+                    ++p;
+                }
+                step.len = p - step.key;
+                if (!step.len) {
+                    json_query_free(q);
+                    return -1;
+                }
+            } else if (*p == '[') {
+                const char *digits = ++p;
+                for (; (unsigned char) (*p - '0') < 10; ++p) {
+                    step.len = step.len * 10 + (*p - '0');
+                }
+                if (p == digits || *p++ != ']') {
+                    json_query_free(q);
+                    return -1;
+                }
+            } else {
+                json_query_free(q);
+                return -1;
+            }
+
+            // reuse an existing child for the same step
+            size_t *link = &q->steps[at].child;
+            while (*link) {
+                const JsonQueryStep *c = &q->steps[*link];
+                if (!c->key == !step.key && c->len == step.len
+                    && (!step.key || !memcmp(c->key, step.key, step.len)))
+                {
+                    break;
+                }
+                link = &q->steps[*link].next;
+            }
+            if (!*link) {
+                q->steps[q->nsteps] = step;
+                *link = q->nsteps++;
+            }
+            at = *link;
+        }
+        if (q->steps[at].field < 0) {
+            q->steps[at].field = i;
+        }
+        q->same[i] = q->steps[at].field;
+        q->nfields = i + 1;
+    }
+
+    // count the fields under each step (children always come after their parent)
+    for (size_t i = q->nsteps; i-- > 0;) {
+        JsonQueryStep *s = &q->steps[i];
+        s->nfields += s->field >= 0;
+        for (size_t c = s->child; c; c = q->steps[c].next) {
+            s->nfields += q->steps[c].nfields;
+        }
+    }
+    return 0;
+}
+
+typedef struct {
+    const JsonQuery *q;
+    JsonQueryField *out;
+    const char *end;
+    size_t left; // fields not found yet
+} JsonQueryRun;
+
+// Matches the value at '*buf' against 'step'. Returns 0 when every field has been found
+// (leaving '*buf' anywhere), 1 otherwise, -1 on malformed input.
+static int
+json_query_value(JsonQueryRun *r, const JsonQueryStep *step, const char **buf)
+{
+    const JsonQueryStep *steps = r->q->steps;
+    const char *start = NULL;
+    const JsonTokenType t = json_advance(buf, r->end, &start);
+    switch (t) {
+        case JTT_MAP_START:
+        case JTT_LIST_START:
+            start = *buf - 1;
+            break;
+        case JTT_TRUE:
+        case JTT_NULL:
+            start = *buf - 4;
+            break;
+        case JTT_FALSE:
+            start = *buf - 5;
+            break;
+        case JTT_STRING:
+        case JTT_NUMBER:
+            break;
+        default:
+            return -1;
+    }
+
+    if (t == JTT_MAP_START && step->child) {
+        while (1) {
+            const char *key = NULL;
+            const JsonTokenType k = json_advance(buf, r->end, &key);
+            if (k == JTT_MAP_END) {
+                break;
+            }
+            if (k != JTT_STRING) {
+                return -1;
+            }
+            const size_t len = *buf - key - 2;
+            const JsonQueryStep *c = NULL;
+            for (size_t i = step->child; i; i = steps[i].next) {
+                if (steps[i].key && steps[i].len == len && !memcmp(steps[i].key, key + 1, len)) {
+                    c = &steps[i];
+                    break;
+                }
+            }
+            if (!c) {
+                const char *p = *buf;
+                const JsonTokenType v = json_advance(&p, r->end, NULL);
+                if (v == JTT_MAP_END || v == JTT_LIST_END || v >= JTT_ERROR) {
+                    return -1;
+                }
+                *buf = p;
+                if (v == JTT_MAP_START || v == JTT_LIST_START) {
+                    json_skip_close(buf, r->end, 1);
+                }
+                continue;
+            }
+            const int ret = json_query_value(r, c, buf);
+            if (ret <= 0) {
+                return ret;
+            }
+        }
+    } else if (t == JTT_LIST_START && step->child) {
+        for (size_t index = 0; ; ++index) {
+            // peek at the element: it is read again only if it is wanted
+            const char *p = *buf;
+            const JsonTokenType k = json_advance(&p, r->end, NULL);
+            if (k == JTT_LIST_END) {
+                *buf = p;
+                break;
+            }
+            if (k == JTT_MAP_END || k >= JTT_ERROR) {
+                return -1;
+            }
+            const JsonQueryStep *c = NULL;
+            for (size_t i = step->child; i; i = steps[i].next) {
+                if (!steps[i].key && steps[i].len == index) {
+                    c = &steps[i];
+                    break;
+                }
+            }
+            if (!c) {
+                *buf = p;
+                if (k == JTT_MAP_START || k == JTT_LIST_START) {
+                    json_skip_close(buf, r->end, 1);
+                }
+                continue;
+            }
+            const int ret = json_query_value(r, c, buf);
+            if (ret <= 0) {
+                return ret;
+            }
+        }
+    } else if (t == JTT_MAP_START || t == JTT_LIST_START) {
+        json_skip_close(buf, r->end, 1);
+    }
+
+    if (step->field >= 0 && r->out[step->field].type == JTT_EOT) {
+        r->out[step->field] = (JsonQueryField) {t, start, *buf};
+        if (!--r->left) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Runs the query on the document at '[buf, end)', filling 'out' (an entry per path). Returns
+// the number of fields found, or -1 if the document is malformed.
+int
+json_query_run(const JsonQuery *q, const char *buf, const char *end, JsonQueryField *out)
+{
+    for (size_t i = 0; i < q->nfields; ++i) {
+        out[i] = (JsonQueryField) {.type = JTT_EOT};
+    }
+    JsonQueryRun r = {.q = q, .out = out, .end = end, .left = q->steps[0].nfields};
+    const int ok = !r.left || json_query_value(&r, &q->steps[0], &buf) >= 0;
+    size_t found = 0;
+    for (size_t i = 0; i < q->nfields; ++i) {
+        out[i] = out[q->same[i]];
+        found += out[i].type != JTT_EOT;
+    }
+    return ok ? (int) found : -1;
+}
+
+//-----------------------------------------------------------------------------
+// Writer: JSON text into a buffer that grows, or that is written to an fd whenever it is
+// full. Separators are added as needed, so a document is just the sequence of calls.
+//
+// Strings are scanned 16 or 32 bytes at a time (8 with SWAR otherwise) for bytes that need
+// escaping and copied in bulk in between; they are assumed to be valid UTF-8, which is
+// copied as is. Integers are formatted 8 digits at a time with SWAR. Doubles get the
+// shortest decimal that reads back as the same double, found with Schubfach (R. Giulietti),
+// which takes the powers of ten from the Eisel-Lemire table above.
+
+typedef struct {
+    char *buf;
+    size_t len;
+    size_t cap;
+    int fd;    // < 0: 'buf' grows, otherwise it is written to 'fd' when full
+    int error; // an allocation or a write failed, and the output is incomplete
+    int sep;   // a ',' goes before the next value
+} JsonWriter;
+
+void
+json_writer_init(JsonWriter *w, int fd)
+{
+    *w = (JsonWriter) {.fd = fd};
+}
+
+void
+json_writer_free(JsonWriter *w)
+{
+    free(w->buf);
+    json_writer_init(w, w->fd);
+}
+
+// In fd mode, writes out the buffer. Returns 0, or -1 if anything was lost so far.
+int
+json_writer_flush(JsonWriter *w)
+{
+    if (w->fd >= 0) {
+        for (size_t off = 0; off < w->len && !w->error; ) {
+            const ssize_t n = write(w->fd, w->buf + off, w->len - off);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                w->error = 1;
+                break;
+            }
+            off += n;
+        }
+        w->len = 0;
+    }
+    return w->error ? -1 : 0;
+}
+
+// Returns room for 'n' bytes at the end of the buffer, or NULL on error.
+static inline char *
+json_writer_reserve(JsonWriter *w, size_t n)
+{
+    if (w->cap - w->len >= n) {
+        return w->buf + w->len;
+    }
+    if (w->fd >= 0 && w->len) {
+        if (json_writer_flush(w) < 0) {
+            return NULL;
+        }
+        if (w->cap >= n) {
+            return w->buf;
+        }
+    }
+    size_t cap = w->cap ? w->cap * 2 : 64 << 10;
+    while (cap - w->len < n) {
+        cap *= 2;
+    }
+    char *buf = realloc(w->buf, cap);
+    if (!buf) {
+        w->error = 1;
+        return NULL;
+    }
+    w->buf = buf;
+    w->cap = cap;
+    return w->buf + w->len;
+}
+
+static void
+json_writer_put(JsonWriter *w, const char *s, size_t n)
+{
+    // in fd mode, long runs go through the buffer a buffer-full at a time
+    while (w->fd >= 0 && w->cap && n > w->cap - w->len) {
+        const size_t k = w->cap - w->len;
+        memcpy(w->buf + w->len, s, k);
+        w->len += k;
+        s += k;
+        n -= k;
+        if (json_writer_flush(w) < 0) {
+            return;
+        }
+    }
+    char *p = json_writer_reserve(w, n);
+    if (p) {
+        memcpy(p, s, n);
+        w->len += n;
+    }
+}
+
+static inline void
+json_writer_putc(JsonWriter *w, char c)
+{
+    char *p = json_writer_reserve(w, 1);
+    if (p) {
+        *p = c;
+        ++w->len;
+    }
+}
+
+static inline void
+json_write_sep(JsonWriter *w)
+{
+    if (w->sep) {
+        json_writer_putc(w, ',');
+    }
+}
+
+void
+json_write_map_start(JsonWriter *w)
+{
+    json_write_sep(w);
+    json_writer_putc(w, '{');
+    w->sep = 0;
+}
+
+void
+json_write_map_end(JsonWriter *w)
+{
+    json_writer_putc(w, '}');
+    w->sep = 1;
+}
+
+void
+json_write_list_start(JsonWriter *w)
+{
+    json_write_sep(w);
+    json_writer_putc(w, '[');
+    w->sep = 0;
+}
+
+void
+json_write_list_end(JsonWriter *w)
+{
+    json_writer_putc(w, ']');
+    w->sep = 1;
+}
+
+// Ends a line of NDJSON.
+void
+json_write_newline(JsonWriter *w)
+{
+    json_writer_putc(w, '\n');
+    w->sep = 0;
+}
+
+// Writes a value that is JSON text already, e.g. a span from the tokenizer.
+void
+json_write_raw(JsonWriter *w, const char *s, size_t n)
+{
+    json_write_sep(w);
+    json_writer_put(w, s, n);
+    w->sep = 1;
+}
+
+void
+json_write_bool(JsonWriter *w, int b)
+{
+    json_write_raw(w, b ? "true" : "false", b ? 4 : 5);
+}
+
+void
+json_write_null(JsonWriter *w)
+{
+    json_write_raw(w, "null", 4);
+}
+
+static JsonEscapeScanFunc json_escape_scan;
+
+// Writes the (unescaped, UTF-8) string '[s, s + n)' as a JSON string.
+void
+json_write_string(JsonWriter *w, const char *s, size_t n)
+{
+    static const char hex[] = "0123456789abcdef";
+    static const char simple[0x20] = {
+        ['\b'] = 'b', ['\f'] = 'f', ['\n'] = 'n', ['\r'] = 'r', ['\t'] = 't',
+    };
+
+    if (!json_escape_scan) {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_cpu_init();
+        json_escape_scan = __builtin_cpu_supports("avx2") ? json_escape_scan_avx2
+            : __builtin_cpu_supports("sse2") ? json_escape_scan_sse2 : json_escape_scan_scalar;
+#else
+        json_escape_scan = json_escape_scan_scalar;
+#endif
+    }
+
+    const char *end = s + n;
+    const char *q = json_escape_scan(s, end);
+    if (q == end) {
+        // nothing to escape: a single copy
+        char *p = json_writer_reserve(w, n + 3);
+        if (!p) {
+            return;
+        }
+        *p = ',';
+        p += w->sep;
+        *p++ = '"';
+        memcpy(p, s, n);
+        p[n] = '"';
+        w->len = p + n + 1 - w->buf;
+        w->sep = 1;
+        return;
+    }
+
+    json_write_sep(w);
+    json_writer_putc(w, '"');
+    while (1) {
+        json_writer_put(w, s, q - s);
+        if (q == end) {
+            break;
+        }
+        char *p = json_writer_reserve(w, 6);
+        if (!p) {
+            return;
+        }
+        const unsigned char c = *q;
+        p[0] = '\\';
+        if (c >= 0x20) {
+            p[1] = c;
+            w->len += 2;
+        } else if (simple[c]) {
+            p[1] = simple[c];
+            w->len += 2;
+        } else {
+            memcpy(p + 1, "u00", 3);
+            p[4] = hex[c >> 4];
+            p[5] = hex[c & 15];
+            w->len += 6;
+        }
+        s = q + 1;
+        q = json_escape_scan(s, end);
+    }
+    json_writer_putc(w, '"');
+    w->sep = 1;
+}
+
+// Writes a map key; the value comes next.
+void
+json_write_key(JsonWriter *w, const char *s, size_t n)
+{
+    json_write_string(w, s, n);
+    json_writer_putc(w, ':');
+    w->sep = 0;
+}
+
+// The 8 ASCII digits of v < 10^8, first digit in the low byte.
+static inline uint64_t
+json_format_8digits(uint32_t v)
+{
+    // two 4-digit halves in 32-bit lanes, then 2-digit quarters in 16-bit lanes, then digits
+    const uint64_t merged = v / 10000 | (uint64_t) (v % 10000) << 32;
+    const uint64_t top = ((merged * 10486) >> 20) & (0x7full << 32 | 0x7full);
+    const uint64_t hundreds = (merged - 100 * top) << 16 | top;
+    uint64_t tens = ((hundreds * 103) >> 10) & 0x000f000f000f000full;
+    tens += (hundreds - 10 * tens) << 8;
+    return tens + 0x3030303030303030ull;
+}
+
+static inline char *
+json_put8(char *p, uint64_t digits)
+{
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    digits = __builtin_bswap64(digits);
+#endif
+    memcpy(p, &digits, 8);
+    return p + 8;
+}
+
+// Writes v < 10^8 without leading zeros. Writes 8 bytes whatever the length.
+static inline char *
+json_put_short(char *p, uint32_t v)
+{
+    const uint64_t digits = json_format_8digits(v);
+    const int lz = v ? __builtin_ctzll(digits ^ 0x3030303030303030ull) / 8 : 7;
+    json_put8(p, digits >> 8 * lz);
+    return p + 8 - lz;
+}
+
+// Writes v in decimal; needs 24 bytes of room.
+static char *
+json_format_u64(char *p, uint64_t v)
+{
+    if (v < 100000000) {
+        return json_put_short(p, v);
+    }
+    if (v < 10000000000000000ull) {
+        p = json_put_short(p, v / 100000000);
+        return json_put8(p, json_format_8digits(v % 100000000));
+    }
+    p = json_put_short(p, v / 10000000000000000ull);
+    p = json_put8(p, json_format_8digits(v / 100000000 % 100000000));
+    return json_put8(p, json_format_8digits(v % 100000000));
+}
+
+void
+json_write_int64(JsonWriter *w, int64_t v)
+{
+    json_write_sep(w);
+    char *p = json_writer_reserve(w, 32);
+    if (!p) {
+        return;
+    }
+    char *o = p;
+    if (v < 0) {
+        *o++ = '-';
+    }
+    o = json_format_u64(o, v < 0 ? 0 - (uint64_t) v : (uint64_t) v);
+    w->len += o - p;
+    w->sep = 1;
+}
+
+static inline uint64_t
+json_round_to_odd(uint64_t hi, uint64_t lo, uint64_t cp)
+{
+    const unsigned __int128 x = (unsigned __int128) cp * lo;
+    const unsigned __int128 y = (unsigned __int128) cp * hi + (uint64_t) (x >> 64);
+    return (uint64_t) (y >> 64) | ((uint64_t) y > 1);
+}
+
+// Schubfach: the shortest decimal sig * 10^exp in the rounding interval of the double
+// sig_bin * 2^exp_bin ('regular' unless it is the smallest of its binade).
+static void
+json_schubfach(uint64_t sig_bin, int exp_bin, int regular, uint64_t *sig, int *exp)
+{
+    const int even = !(sig_bin & 1);
+    const uint64_t cbl = 4 * sig_bin - 2 + !regular; // the lower neighbour is closer
+    const uint64_t cb = 4 * sig_bin;
+    const uint64_t cbr = 4 * sig_bin + 2;
+
+    // k = floor(log10(2^exp_bin)), or floor(log10(3/4 * 2^exp_bin)) at a binade boundary
+    const int k = (exp_bin * 315653 - (regular ? 0 : 131237)) >> 20;
+    const int exp10 = -k;
+    const int h = exp_bin + ((exp10 * 217707) >> 16) + 1;
+    const uint64_t *g = json_pow5_128[exp10 + 342];
+    const uint64_t g1 = g[0], g0 = g[1] + (exp10 < -27 || exp10 > 55);
+
+    const uint64_t vbl = json_round_to_odd(g1, g0, cbl << h);
+    const uint64_t vb = json_round_to_odd(g1, g0, cb << h);
+    const uint64_t vbr = json_round_to_odd(g1, g0, cbr << h);
+    const uint64_t lower = vbl + !even;
+    const uint64_t upper = vbr - !even;
+
+    const uint64_t s = vb / 4;
+    if (s >= 10) {
+        const uint64_t sp = s / 10;
+        const int u_in = lower <= 40 * sp;
+        const int w_in = upper >= 40 * sp + 40;
+        if (u_in != w_in) {
+            *sig = sp + w_in;
+            *exp = k + 1;
+            return;
+        }
+    }
+    const int u_in = lower <= 4 * s;
+    const int w_in = upper >= 4 * s + 4;
+    const uint64_t mid = 4 * s + 2;
+    const int round_up = vb > mid || (vb == mid && (s & 1));
+    *sig = s + (u_in != w_in ? w_in : round_up);
+    *exp = k;
+}
+
+// Writes the shortest representation of a finite 'd' that reads back as 'd': plain decimal
+// notation (with at least one digit after the point) when the point is within 21 digits of
+// the first digit and no more than 6 zeros follow it, exponent notation otherwise. Needs 32
+// bytes of room.
+static char *
+json_format_double(char *p, double d)
+{
+    uint64_t bits;
+    memcpy(&bits, &d, sizeof(bits));
+    if (bits >> 63) {
+        *p++ = '-';
+    }
+    const uint64_t sig_raw = bits & ((1ull << 52) - 1);
+    const int exp_raw = bits >> 52 & 0x7ff;
+    if (!exp_raw && !sig_raw) {
+        memcpy(p, "0.0", 3);
+        return p + 3;
+    }
+
+    uint64_t sig;
+    int exp;
+    const uint64_t sig_bin = exp_raw ? sig_raw | 1ull << 52 : sig_raw;
+    const int exp_bin = (exp_raw ? exp_raw : 1) - 1075;
+    if (exp_bin <= 0 && exp_bin >= -52 && !(sig_bin & ((1ull << -exp_bin) - 1))) {
+        // an integer below 2^53
+        sig = sig_bin >> -exp_bin;
+        exp = 0;
+    } else {
+        json_schubfach(sig_bin, exp_bin, !sig_raw && exp_raw > 1 ? 0 : 1, &sig, &exp);
+    }
+    while (sig % 10 == 0) {
+        sig /= 10;
+        ++exp;
+    }
+
+    char digits[24];
+    const int n = json_format_u64(digits, sig) - digits;
+    const int dp = n + exp; // position of the point after the first digit
+    if (dp > 0 && dp <= 21) {
+        if (dp >= n) {
+            memcpy(p, digits, n);
+            memset(p + n, '0', dp - n);
+            memcpy(p + dp, ".0", 2);
+            return p + dp + 2;
+        }
+        memcpy(p, digits, dp);
+        p[dp] = '.';
+        memcpy(p + dp + 1, digits + dp, n - dp);
+        return p + n + 1;
+    }
+    if (dp <= 0 && dp > -6) {
+        memcpy(p, "0.", 2);
+        memset(p + 2, '0', -dp);
+        memcpy(p + 2 - dp, digits, n);
+        return p + 2 - dp + n;
+    }
+    *p++ = digits[0];
+    if (n > 1) {
+        *p++ = '.';
+        memcpy(p, digits + 1, n - 1);
+        p += n - 1;
+    }
+    *p++ = 'e';
+    int e = dp - 1;
+    if (e < 0) {
+        *p++ = '-';
+        e = -e;
+    }
+    return json_put_short(p, e);
+}
+
+// Writes a double; JSON has no infinities or NaNs, which are written as null.
+void
+json_write_double(JsonWriter *w, double d)
+{
+    if (!__builtin_isfinite(d)) {
+        json_write_null(w);
+        return;
+    }
+    json_write_sep(w);
+    char *p = json_writer_reserve(w, 40);
+    if (!p) {
+        return;
+    }
+    w->len += json_format_double(p, d) - p;
+    w->sep = 1;
+}
@@ -0,0 +1,724 @@
+// Benchmarks for json.c, which it includes to get at the scalar and SIMD variants of each
+// stage directly.
+//
+// Compile with:
+//   gcc -O2 json_bench.c -o json_bench
+#include "json.c"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+static void *
+xmalloc(size_t n)
+{
+    void *r = malloc(n);
+    if (!r && n) {
+        fprintf(stderr, "Out of memory.\n");
+        abort();
+    }
+    return r;
+}
+
+static double
+now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static uint64_t rng_state = 88172645463325252ull;
+
+static uint64_t
+rng_next(void)
+{
+    uint64_t x = rng_state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return rng_state = x;
+}
+
+typedef struct {
+    char *v;
+    size_t len;
+    size_t cap;
+} Buf;
+
+static void
+buf_put(Buf *b, const char *s, size_t n)
+{
+    if (b->cap - b->len < n) {
+        while (b->cap - b->len < n) {
+            b->cap = b->cap ? b->cap * 2 : 4096;
+        }
+        char *v = realloc(b->v, b->cap);
+        if (!v) {
+            fprintf(stderr, "Out of memory.\n");
+            abort();
+        }
+        b->v = v;
+    }
+    memcpy(b->v + b->len, s, n);
+    b->len += n;
+}
+
+// Evaluates the body over and over for half a second, and returns the best rate in GB/s.
+#define MEASURE(Bytes_, ...) ({ \
+        double best_ = 0; \
+        for (double t0_ = now(), t1_ = t0_; t1_ - t0_ < 0.5; ) { \
+            const double s_ = now(); \
+            __VA_ARGS__; \
+            t1_ = now(); \
+            if ((Bytes_) / (t1_ - s_) > best_) { best_ = (Bytes_) / (t1_ - s_); } \
+        } \
+        best_ / 1e9; \
+    })
+
+//-----------------------------------------------------------------------------
+// strings
+
+// String contents (escaped, without the quotes) of about 'size' bytes: words from 'alphabet',
+// with an escape every 'escape_every' words on average.
+static void
+gen_strings(Buf *b, size_t size, const char *const *alphabet, size_t nalphabet, int escape_every)
+{
+    static const char *const escapes[] = {
+        "\\n", "\\\"", "\\\\", "\\u00e9", "\\ud83d\\ude00", "\\t",
+    };
+    while (b->len < size) {
+        const char *w = alphabet[rng_next() % nalphabet];
+        buf_put(b, w, strlen(w));
+        if (escape_every && !(rng_next() % escape_every)) {
+            const char *e = escapes[rng_next() % (sizeof(escapes) / sizeof(*escapes))];
+            buf_put(b, e, strlen(e));
+        } else {
+            buf_put(b, " ", 1);
+        }
+    }
+}
+
+static void
+bench_strings(const char *name, const Buf *in)
+{
+    static const struct {
+        const char *name;
+        JsonUnescapeFunc f;
+    } unescapers[] = {
+        {"scalar", json_unescape_scalar},
+#if defined(__x86_64__) || defined(__i386__)
+        {"sse2", json_unescape_sse2},
+        {"avx2", json_unescape_avx2},
+#endif
+    };
+    static const struct {
+        const char *name;
+        JsonUtf8Func f;
+    } validators[] = {
+        {"scalar", json_utf8_valid_scalar},
+#if defined(__x86_64__) || defined(__i386__)
+        {"avx2", json_utf8_valid_avx2},
+#endif
+    };
+
+    const unsigned char *s = (const unsigned char *) in->v;
+    for (size_t i = 0; i < sizeof(validators) / sizeof(*validators); ++i) {
+        if (!strcmp(validators[i].name, "avx2") && !__builtin_cpu_supports("avx2")) {
+            continue;
+        }
+        int ok = 1;
+        const double gbs = MEASURE(in->len, ok &= validators[i].f(s, s + in->len));
+        printf("%-6s utf8 validate  %-6s %6.2f GB/s%s\n",
+               name, validators[i].name, gbs, ok ? "" : "  (INVALID)");
+    }
+
+    char *out = xmalloc(in->len);
+    for (size_t i = 0; i < sizeof(unescapers) / sizeof(*unescapers); ++i) {
+        if (!strcmp(unescapers[i].name, "avx2") && !__builtin_cpu_supports("avx2")) {
+            continue;
+        }
+        const char *r = in->v;
+        char *o;
+        const double gbs = MEASURE(in->len, r = unescapers[i].f(in->v, in->v + in->len, out, &o));
+        printf("%-6s unescape       %-6s %6.2f GB/s%s\n",
+               name, unescapers[i].name, gbs, r ? "" : "  (INVALID)");
+    }
+    size_t len = 0;
+    const double gbs = MEASURE(in->len, json_string_unescape(in->v, in->v + in->len, out, &len));
+    printf("%-6s string_unescape (validate + unescape) %6.2f GB/s\n", name, gbs);
+    free(out);
+}
+
+//-----------------------------------------------------------------------------
+// documents
+
+static void
+gen_string(Buf *b, const char *const *alphabet, size_t nalphabet)
+{
+    buf_put(b, "\"", 1);
+    for (int n = rng_next() % 8; n >= 0; --n) {
+        const char *w = alphabet[rng_next() % nalphabet];
+        buf_put(b, w, strlen(w));
+        if (rng_next() % 16) {
+            buf_put(b, " ", 1);
+        } else {
+            buf_put(b, "\\n", 2);
+        }
+    }
+    buf_put(b, "\"", 1);
+}
+
+static void
+gen_value(Buf *b, int depth, const char *const *alphabet, size_t nalphabet)
+{
+    char tmp[32];
+    const unsigned r = rng_next() % (depth < 4 ? 10 : 7);
+    switch (r) {
+        case 0: case 1:
+            gen_string(b, alphabet, nalphabet);
+            break;
+        case 2: {
+            const uint64_t x = rng_next() >> (rng_next() % 64);
+            buf_put(b, tmp, snprintf(tmp, sizeof(tmp), "%lld", (long long) x / 3));
+            break;
+        }
+        case 3: {
+            uint64_t x = rng_next() % 100000000;
+            const double scale = rng_next() % 2 ? 1 : 1e-9;
+            buf_put(b, tmp, snprintf(tmp, sizeof(tmp), "%.17g", x / 1000.0 * scale));
+            break;
+        }
+        case 4: buf_put(b, "true", 4); break;
+        case 5: buf_put(b, "false", 5); break;
+        case 6: buf_put(b, "null", 4); break;
+        case 7: case 8: {
+            buf_put(b, "{", 1);
+            for (int n = rng_next() % 8, i = 0; i < n; ++i) {
+                if (i) {
+                    buf_put(b, ",", 1);
+                }
+                const int field = rng_next() % 32;
+                buf_put(b, tmp, snprintf(tmp, sizeof(tmp), "\"field_%d\":", field));
+                gen_value(b, depth + 1, alphabet, nalphabet);
+            }
+            buf_put(b, "}", 1);
+            break;
+        }
+        case 9: {
+            buf_put(b, "[", 1);
+            for (int n = rng_next() % 8, i = 0; i < n; ++i) {
+                if (i) {
+                    buf_put(b, ",", 1);
+                }
+                gen_value(b, depth + 1, alphabet, nalphabet);
+            }
+            buf_put(b, "]", 1);
+            break;
+        }
+    }
+}
+
+// NDJSON of about 'size' bytes: objects of random values, nested a few levels.
+static void
+gen_docs(Buf *b, size_t size, const char *const *alphabet, size_t nalphabet)
+{
+    while (b->len < size) {
+        buf_put(b, "{\"id\":", 6);
+        char tmp[24];
+        buf_put(b, tmp, snprintf(tmp, sizeof(tmp), "%zu", b->len));
+        for (int n = 1 + rng_next() % 8; n; --n) {
+            buf_put(b, tmp, snprintf(tmp, sizeof(tmp), ",\"k%d\":", (int) (rng_next() % 100)));
+            gen_value(b, 0, alphabet, nalphabet);
+        }
+        buf_put(b, "}\n", 2);
+    }
+}
+
+// Parses 'in' token by token and writes it back out: strings unescaped and escaped again,
+// numbers converted to int64 or double and formatted again. Returns 0 on malformed input.
+static int
+roundtrip(const Buf *in, JsonWriter *w, char *scratch)
+{
+    unsigned char in_map[256]; // per level: 1 map, 0 list
+    unsigned char key_next[256];
+    int depth = 0;
+    w->len = 0;
+    const char *p = in->v, *end = in->v + in->len;
+    while (1) {
+        const char *start;
+        const JsonTokenType t = json_advance(&p, end, &start);
+        switch (t) {
+            case JTT_MAP_START:
+            case JTT_LIST_START:
+                if (depth == 256) {
+                    return 0;
+                }
+                if (depth && in_map[depth - 1]) {
+                    key_next[depth - 1] = 1;
+                }
+                in_map[depth] = t == JTT_MAP_START;
+                key_next[depth] = 1;
+                ++depth;
+                if (t == JTT_MAP_START) {
+                    json_write_map_start(w);
+                } else {
+                    json_write_list_start(w);
+                }
+                break;
+
+            case JTT_MAP_END:
+            case JTT_LIST_END:
+                if (!depth--) {
+                    return 0;
+                }
+                if (t == JTT_MAP_END) {
+                    json_write_map_end(w);
+                } else {
+                    json_write_list_end(w);
+                }
+                if (!depth) {
+                    json_write_newline(w);
+                }
+                break;
+
+            case JTT_STRING: {
+                size_t len;
+                if (!json_string_unescape(start + 1, p - 1, scratch, &len)) {
+                    return 0;
+                }
+                if (depth && in_map[depth - 1] && key_next[depth - 1]) {
+                    json_write_key(w, scratch, len);
+                    key_next[depth - 1] = 0;
+                } else {
+                    json_write_string(w, scratch, len);
+                    if (depth && in_map[depth - 1]) {
+                        key_next[depth - 1] = 1;
+                    }
+                }
+                break;
+            }
+
+            case JTT_NUMBER: {
+                int64_t i;
+                double d;
+                if (json_number_int64(start, p, &i)) {
+                    json_write_int64(w, i);
+                } else if (json_number_double(start, p, &d)) {
+                    json_write_double(w, d);
+                } else {
+                    return 0;
+                }
+                if (depth && in_map[depth - 1]) {
+                    key_next[depth - 1] = 1;
+                }
+                break;
+            }
+
+            case JTT_TRUE:
+            case JTT_FALSE:
+            case JTT_NULL:
+                if (t == JTT_NULL) {
+                    json_write_null(w);
+                } else {
+                    json_write_bool(w, t == JTT_TRUE);
+                }
+                if (depth && in_map[depth - 1]) {
+                    key_next[depth - 1] = 1;
+                }
+                break;
+
+            case JTT_EOT:
+                return !depth && !w->error;
+
+            default:
+                return 0;
+        }
+    }
+}
+
+// Checks that 'a' and 'b' have the same tokens, with the same string contents and the same
+// numeric values.
+static int
+same_tokens(const char *a, const char *a_end, const char *b, const char *b_end, char *s1, char *s2)
+{
+    while (1) {
+        const char *sa, *sb;
+        const JsonTokenType ta = json_advance(&a, a_end, &sa), tb = json_advance(&b, b_end, &sb);
+        if (ta != tb) {
+            return 0;
+        }
+        if (ta == JTT_STRING) {
+            size_t la, lb;
+            if (!json_string_unescape(sa + 1, a - 1, s1, &la)
+                || !json_string_unescape(sb + 1, b - 1, s2, &lb)
+                || la != lb || memcmp(s1, s2, la))
+            {
+                return 0;
+            }
+        } else if (ta == JTT_NUMBER) {
+            double da, db;
+            if (!json_number_double(sa, a, &da) || !json_number_double(sb, b, &db) || da != db) {
+                return 0;
+            }
+        } else if (ta == JTT_EOT || ta == JTT_ERROR) {
+            return ta == JTT_EOT;
+        }
+    }
+}
+
+static void
+bench_roundtrip(const char *name, const Buf *in)
+{
+    JsonWriter w;
+    json_writer_init(&w, -1);
+    char *scratch = xmalloc(in->len), *scratch2 = xmalloc(in->len);
+
+    int ok = roundtrip(in, &w, scratch)
+        && same_tokens(in->v, in->v + in->len, w.buf, w.buf + w.len, scratch, scratch2);
+    const double gbs = MEASURE(in->len, ok &= roundtrip(in, &w, scratch));
+    printf("%-6s parse + write  %6.2f GB/s  (%zu -> %zu bytes)%s\n",
+           name, gbs, in->len, w.len, ok ? "" : "  (MISMATCH)");
+
+    const char *p = in->v;
+    const double tok = MEASURE(in->len, {
+        p = in->v;
+        while (json_advance(&p, in->v + in->len, NULL) < JTT_ERROR) {}
+    });
+    printf("%-6s tokenize only  %6.2f GB/s\n", name, tok);
+
+    free(scratch2);
+    free(scratch);
+    json_writer_free(&w);
+}
+
+//-----------------------------------------------------------------------------
+// tokenizer
+
+// Numbers only: lists of integers, decimals and exponents, one per line.
+static void
+gen_numeric(Buf *b, size_t size)
+{
+    char tmp[32];
+    while (b->len < size) {
+        buf_put(b, "[", 1);
+        for (int i = 0; i < 16; ++i) {
+            const uint64_t r = rng_next();
+            const double scale = r % 2 ? 1e100 : 1e-100;
+            int n;
+            switch (r % 4) {
+                case 0:
+                    n = snprintf(tmp, sizeof(tmp), "%lld", (long long) (r >> (r % 64)) / 7);
+                    break;
+                case 1: n = snprintf(tmp, sizeof(tmp), "%.3f", (double) (r >> 44) / 7); break;
+                case 2: n = snprintf(tmp, sizeof(tmp), "%.17g", (r >> 11) * 0x1p-53); break;
+                default: n = snprintf(tmp, sizeof(tmp), "%.6e", (r >> 11) * scale); break;
+            }
+            buf_put(b, tmp, n);
+            buf_put(b, i == 15 ? "]\n" : ",", i == 15 ? 2 : 1);
+        }
+    }
+}
+
+// Long strings with escapes, a few per line.
+static void
+gen_string_docs(Buf *b, size_t size, const char *const *alphabet, size_t nalphabet)
+{
+    while (b->len < size) {
+        buf_put(b, "{\"title\":", 9);
+        gen_string(b, alphabet, nalphabet);
+        buf_put(b, ",\"text\":\"", 9);
+        Buf text = {0};
+        gen_strings(&text, 256 + rng_next() % 1024, alphabet, nalphabet, 20);
+        buf_put(b, text.v, text.len);
+        free(text.v);
+        buf_put(b, "\",\"tags\":[", 10);
+        gen_string(b, alphabet, nalphabet);
+        buf_put(b, ",", 1);
+        gen_string(b, alphabet, nalphabet);
+        buf_put(b, "]}\n", 3);
+    }
+}
+
+// Maps and lists nested 64 deep, with a few scalars at each level.
+static void
+gen_nested(Buf *b, size_t size)
+{
+    while (b->len < size) {
+        for (int i = 0; i < 32; ++i) {
+            buf_put(b, "{\"n\":1,\"a\":[true,", 17);
+        }
+        buf_put(b, "null", 4);
+        for (int i = 0; i < 32; ++i) {
+            buf_put(b, ",\"x\"]}", 6);
+        }
+        buf_put(b, "\n", 1);
+    }
+}
+
+// Many small flat documents, one per line.
+static void
+gen_small_docs(Buf *b, size_t size)
+{
+    char tmp[64];
+    static const char *const status[] = {"ok", "error", "pending"};
+    for (uint64_t id = 0; b->len < size; ++id) {
+        const uint64_t r = rng_next();
+        buf_put(b, tmp, snprintf(tmp, sizeof(tmp),
+                                 "{\"id\":%llu,\"status\":\"%s\",\"ok\":%s,\"ms\":%.2f}\n",
+                                 (unsigned long long) id, status[r % 3], r & 4 ? "true" : "false",
+                                 (double) (r >> 40) / 1000));
+    }
+}
+
+// The number of tokens and a hash of their types and contents (strings without the quotes),
+// to check that the tokenizers agree.
+typedef struct {
+    size_t n;
+    uint64_t h;
+} TokDigest;
+
+static void
+digest_add(TokDigest *d, uint64_t v, const char *s, const char *end)
+{
+    uint64_t h = (d->h ^ v) * 0x100000001b3ull;
+    for (; s != end; ++s) {
+        h = (h ^ (unsigned char) *s) * 0x100000001b3ull;
+    }
+    d->h = h;
+    ++d->n;
+}
+
+// Adds a token as returned by json_advance(), where strings keep their quotes.
+static void
+digest_token(TokDigest *d, JsonTokenType t, const char *start, const char *stop)
+{
+    if (t == JTT_STRING) {
+        digest_add(d, t, start + 1, stop - 1);
+    } else if (t == JTT_NUMBER) {
+        digest_add(d, t, start, stop);
+    } else {
+        digest_add(d, t, NULL, NULL);
+    }
+}
+
+// Each of these goes through the whole input, adds the tokens to 'd' unless it is NULL,
+// and returns the number of tokens.
+
+static size_t
+tok_advance(const Buf *in, TokDigest *d)
+{
+    const char *p = in->v, *end = in->v + in->len, *start = NULL;
+    size_t n = 0;
+    JsonTokenType t;
+    while ((t = json_advance(&p, end, &start)) != JTT_EOT) {
+        ++n;
+        if (d) {
+            digest_token(d, t, start, p);
+        }
+        if (t == JTT_ERROR) {
+            break;
+        }
+    }
+    return n;
+}
+
+static size_t
+tok_iter(const Buf *in, TokDigest *d)
+{
+    JsonIter it;
+    json_iter_init(&it, in->v, in->v + in->len);
+    const char *start = NULL;
+    size_t n = 0;
+    JsonTokenType t;
+    while ((t = json_iter_advance(&it, &start)) != JTT_EOT) {
+        ++n;
+        if (d) {
+            digest_token(d, t, start, it.cur);
+        }
+        if (t == JTT_ERROR) {
+            break;
+        }
+    }
+    return n;
+}
+
+static size_t
+tok_stream(const Buf *in, size_t chunk, TokDigest *d)
+{
+    JsonStream js;
+    json_stream_init(&js);
+    const char *p = in->v, *end = in->v + in->len;
+    size_t n = 0;
+    do {
+        const char *q = end - p > (ptrdiff_t) chunk ? p + chunk : end;
+        json_stream_feed(&js, p, q, q == end);
+        p = q;
+        const char *start = NULL, *stop = NULL;
+        JsonTokenType t;
+        while ((t = json_stream_advance(&js, &start, &stop)) != JTT_MORE && t != JTT_EOT) {
+            ++n;
+            if (d) {
+                digest_token(d, t, start, stop);
+            }
+            if (t == JTT_ERROR) {
+                p = end;
+                break;
+            }
+        }
+    } while (p != end);
+    json_stream_free(&js);
+    return n;
+}
+
+static size_t
+tok_tape(const Buf *in, JsonTape *tape, TokDigest *d)
+{
+    const char *p = in->v, *end = in->v + in->len;
+    size_t n = 0;
+    JsonTokenType t;
+    while ((t = json_tape_parse(tape, &p, end)) != JTT_EOT) {
+        if (t == JTT_ERROR) {
+            ++n;
+            if (d) {
+                digest_add(d, t, NULL, NULL);
+            }
+            break;
+        }
+        for (size_t i = 0; i < tape->len; ++n) {
+            const JsonTokenType tt = json_tape_type(tape, i);
+            if (tt == JTT_STRING || tt == JTT_NUMBER) {
+                if (d) {
+                    size_t len;
+                    const char *s = json_tape_str(tape, i, &len);
+                    digest_add(d, tt, s, s + len);
+                }
+                i += 2;
+            } else {
+                if (d) {
+                    digest_add(d, tt, NULL, NULL);
+                }
+                ++i;
+            }
+        }
+    }
+    return n;
+}
+
+// Skips value after value, adding where each one ends; returns the number of values.
+static size_t
+skip_values(const Buf *in, void (*skip)(const char **buf, const char *end), TokDigest *d)
+{
+    const char *p = in->v, *end = in->v + in->len;
+    size_t n = 0;
+    while (p != end) {
+        skip(&p, end);
+        ++n;
+        if (d) {
+            digest_add(d, p - in->v, NULL, NULL);
+        }
+    }
+    return n;
+}
+
+static void
+bench_tokenizer(const char *name, const Buf *in)
+{
+    JsonTape tape;
+    json_tape_init(&tape);
+
+    // the token streams, checked against json_advance() outside of the timed loops
+    TokDigest ref = {0}, d;
+    tok_advance(in, &ref);
+#define CHECK(Expr_) (d = (TokDigest) {0}, (Expr_), d.n == ref.n && d.h == ref.h)
+    const int iter_ok = CHECK(tok_iter(in, &d));
+    const int stream_ok = CHECK(tok_stream(in, 65536, &d)) && CHECK(tok_stream(in, 61, &d))
+        && CHECK(tok_stream(in, 1, &d));
+    const int tape_ok = CHECK(tok_tape(in, &tape, &d));
+#undef CHECK
+    TokDigest skip = {0}, skip_fast = {0};
+    skip_values(in, json_skip, &skip);
+    skip_values(in, json_skip_fast, &skip_fast);
+    const int skip_ok = skip.n == skip_fast.n && skip.h == skip_fast.h;
+
+    size_t n = 0;
+    double gbs = MEASURE(in->len, n = tok_advance(in, NULL));
+    printf("%-8s json_advance      %6.2f GB/s  %zu tokens\n", name, gbs, n);
+    gbs = MEASURE(in->len, n = tok_iter(in, NULL));
+    printf("%-8s json_iter_advance %6.2f GB/s%s\n", name, gbs, iter_ok ? "" : "  (MISMATCH)");
+    gbs = MEASURE(in->len, n = tok_stream(in, 65536, NULL));
+    printf("%-8s json_stream 64k   %6.2f GB/s%s\n", name, gbs, stream_ok ? "" : "  (MISMATCH)");
+    gbs = MEASURE(in->len, n = tok_tape(in, &tape, NULL));
+    printf("%-8s json_tape_parse   %6.2f GB/s%s\n", name, gbs, tape_ok ? "" : "  (MISMATCH)");
+    gbs = MEASURE(in->len, n = skip_values(in, json_skip, NULL));
+    printf("%-8s json_skip         %6.2f GB/s  %zu values\n", name, gbs, n);
+    gbs = MEASURE(in->len, n = skip_values(in, json_skip_fast, NULL));
+    printf("%-8s json_skip_fast    %6.2f GB/s%s\n", name, gbs, skip_ok ? "" : "  (MISMATCH)");
+
+    json_tape_free(&tape);
+}
+
+static void
+usage(const char *argv0)
+{
+    fprintf(stderr,
+            "USAGE: %s [-s MB]\n"
+            "  -s MB  size of each generated input (default: 16)\n",
+            argv0);
+    exit(2);
+}
+
+int
+main(int argc, char **argv)
+{
+    size_t size = 16 << 20;
+    for (int c; (c = getopt(argc, argv, "s:h")) != -1;) {
+        switch (c) {
+            case 's': size = (size_t) atoi(optarg) << 20; break;
+            default: usage(argv[0]);
+        }
+    }
+    if (!size) {
+        usage(argv[0]);
+    }
+
+    static const char *const ascii[] = {
+        "the", "quick", "brown", "fox", "jumps", "over", "lazy", "dog", "lorem", "ipsum",
+        "request_id", "timestamp", "2024-01-01T00:00:00Z", "GET", "/api/v1/items",
+    };
+    static const char *const cjk[] = {
+        "\xe4\xb8\xad\xe6\x96\x87", "\xe6\x97\xa5\xe6\x9c\xac\xe8\xaa\x9e",
+        "\xed\x95\x9c\xea\xb5\xad\xec\x96\xb4", "\xe6\xbc\xa2\xe5\xad\x97",
+        "\xe3\x81\xb2\xe3\x82\x89\xe3\x81\x8c\xe3\x81\xaa", "\xe6\x95\xb0\xe6\x8d\xae",
+        "\xe6\x9c\x8d\xe5\x8a\xa1\xe5\x99\xa8", "\xe8\xaf\xb7\xe6\xb1\x82",
+    };
+
+    Buf a = {0}, k = {0};
+    gen_numeric(&a, size);
+    bench_tokenizer("numeric", &a);
+    a.len = 0;
+    gen_string_docs(&a, size, ascii, sizeof(ascii) / sizeof(*ascii));
+    bench_tokenizer("strings", &a);
+    a.len = 0;
+    gen_nested(&a, size);
+    bench_tokenizer("nested", &a);
+    a.len = 0;
+    gen_small_docs(&a, size);
+    bench_tokenizer("small", &a);
+    a.len = 0;
+
+    gen_strings(&a, size, ascii, sizeof(ascii) / sizeof(*ascii), 50);
+    gen_strings(&k, size, cjk, sizeof(cjk) / sizeof(*cjk), 50);
+    bench_strings("ascii", &a);
+    bench_strings("cjk", &k);
+
+    a.len = k.len = 0;
+    gen_docs(&a, size, ascii, sizeof(ascii) / sizeof(*ascii));
+    gen_docs(&k, size, cjk, sizeof(cjk) / sizeof(*cjk));
+    bench_roundtrip("ascii", &a);
+    bench_roundtrip("cjk", &k);
+    free(a.v);
+    free(k.v);
+    return 0;
+}
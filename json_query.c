@@ -0,0 +1,133 @@
+// Prints fields of every line of an NDJSON file: one output line per input line, with the
+// values (as written in the input) of the given paths separated by tabs, empty when missing
+// (all of them on a blank line).
+//
+// Compile with:
+//   gcc -O2 -pthread json_query.c -o json_query
+// Example:
+//   json_query events.ndjson .user.id '.items[0].sku' .ts
+#include "json.c"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+typedef struct {
+    char *v;
+    size_t len;
+    size_t cap;
+    size_t errors;
+} Output;
+
+static void
+out_put(Output *o, const char *s, size_t n)
+{
+    if (o->cap - o->len < n) {
+        while (o->cap - o->len < n) {
+            o->cap = o->cap ? o->cap * 2 : 64 << 10;
+        }
+        char *v = realloc(o->v, o->cap);
+        if (!v) {
+            fprintf(stderr, "Out of memory.\n");
+            abort();
+        }
+        o->v = v;
+    }
+    memcpy(o->v + o->len, s, n);
+    o->len += n;
+}
+
+static JsonQuery query;
+
+static void
+on_line(void *arg, void *result, JsonTape *tape, const char *s, const char *end)
+{
+    (void) arg;
+    (void) tape;
+    Output *o = result;
+    JsonQueryField fields[query.nfields];
+    // a blank line finds nothing, which is not an error
+    if (json_query_run(&query, s, end, fields) < 0 && s != end) {
+        ++o->errors;
+    }
+    for (size_t i = 0; i < query.nfields; ++i) {
+        if (i) {
+            out_put(o, "\t", 1);
+        }
+        if (fields[i].type != JTT_EOT) {
+            out_put(o, fields[i].start, fields[i].end - fields[i].start);
+        }
+    }
+    out_put(o, "\n", 1);
+}
+
+static size_t nerrors;
+
+static void
+on_merge(void *arg, void *result)
+{
+    (void) arg;
+    Output *o = result;
+    fwrite(o->v, 1, o->len, stdout);
+    nerrors += o->errors;
+    o->len = 0;
+    o->errors = 0;
+}
+
+static void
+on_release(void *arg, void *result)
+{
+    (void) arg;
+    free(((Output *) result)->v);
+}
+
+static void
+usage(const char *argv0)
+{
+    fprintf(stderr,
+            "USAGE: %s [-t THREADS] [-c CHUNK_KB] [-H] FILE PATH...\n"
+            "  PATH         .key, [index], or a sequence of those (.a.b[3].c); '.' for the line\n"
+            "  -t THREADS   worker threads (default: one per CPU)\n"
+            "  -c CHUNK_KB  chunk size (default: 1024)\n"
+            "  -H           ask for huge pages on the mapping\n",
+            argv0);
+    exit(2);
+}
+
+int
+main(int argc, char **argv)
+{
+    JsonNdjson nd = {
+        .line = on_line,
+        .merge = on_merge,
+        .release = on_release,
+        .result_size = sizeof(Output),
+        .empty_lines = 1,
+    };
+    for (int c; (c = getopt(argc, argv, "t:c:Hh")) != -1;) {
+        switch (c) {
+            case 't': nd.nthreads = atoi(optarg); break;
+            case 'c': nd.chunk_size = (size_t) atoi(optarg) << 10; break;
+            case 'H': nd.hugepages = 1; break;
+            default: usage(argv[0]);
+        }
+    }
+    if (argc - optind < 2) {
+        usage(argv[0]);
+    }
+
+    const char *const *paths = (const char *const *) argv + optind + 1;
+    if (json_query_compile(&query, paths, argc - optind - 1) < 0) {
+        fprintf(stderr, "Invalid path.\n");
+        return 2;
+    }
+    if (json_ndjson_file(argv[optind], &nd) < 0) {
+        perror(argv[optind]);
+        return 1;
+    }
+    json_query_free(&query);
+    if (nerrors) {
+        fprintf(stderr, "%zu malformed lines.\n", nerrors);
+        return 1;
+    }
+    return 0;
+}